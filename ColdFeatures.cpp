@@ -0,0 +1,424 @@
+/*
+ * ColdFeatures.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "ColdFeatures.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+struct ColdHeader
+// data structure for the header of a cold segment file
+{
+	char magic[4];
+	boost::uint32_t version;
+	boost::uint32_t blocks;
+	boost::uint32_t next_id;
+	boost::uint64_t entries;
+	boost::uint64_t index_offset;
+};
+
+static const boost::uint32_t ColdVersion = 1;
+
+static void putVarint ( string& out, boost::uint64_t v )
+{
+	while ( v >= 0x80 ) {
+		out += char ( ( v & 0x7f ) | 0x80 );
+		v >>= 7;
+	}
+	out += char ( v );
+}
+
+static bool getVarint ( const string& in, size_t& pos, boost::uint64_t& v )
+{
+	v = 0;
+	for ( unsigned int shift = 0; pos < in.size() && shift < 64; shift += 7 ) {
+		unsigned char c = in[pos++];
+		v |= boost::uint64_t ( c & 0x7f ) << shift;
+		if ( ! ( c & 0x80 ) ) return true;
+	}
+	return false;
+}
+
+static boost::uint64_t hashPhrase ( const string& phrase )
+// FNV-1a, mixed so both halves can seed the Bloom filter hashes
+{
+	boost::uint64_t h = 14695981039346656037ULL;
+	for ( unsigned int i = 0; i < phrase.size(); ++i )
+		h = ( h ^ (unsigned char) phrase[i] ) * 1099511628211ULL;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+ColdCounters::ColdCounters ()
+	: lookups(0), bloom_rejects(0), cache_hits(0), block_loads(0), hits(0)
+{}
+
+ColdFeatures::ColdFeatures ()
+	: lock (), segment (), index (), cache (), lru (), CacheBytes (0),
+	  cached_bytes (0), next_id (0), lookups (0), bloom_rejects (0),
+	  cache_hits (0), block_loads (0), hits (0), error_msg ()
+{}
+
+bool ColdFeatures::Write ( const string& segment_file,
+		const FeaturesTable& cold, int next_id )
+// write cold features as a segment file; return false on error
+{
+	ofstream out ( segment_file.c_str(), ios::out | ios::binary | ios::trunc );
+	if ( ! out.good() )
+		return false;
+
+	ColdHeader header;
+	memset ( &header, 0, sizeof ( header ) );
+	out.write ( reinterpret_cast<const char*> ( &header ), sizeof ( header ) );
+
+	vector<BlockIndex> blocks;
+	boost::uint64_t offset = sizeof ( header );
+
+	FeaturesTable::const_iterator it = cold.begin();
+	while ( it != cold.end() ) {
+		BlockIndex bi;
+		bi.offset = offset;
+		bi.entries = 0;
+		bi.first = it->first;
+
+		string data, previous;
+		FeaturesTable::const_iterator start = it;
+		for ( ; it != cold.end() && data.size() < BlockBytes; it++ ) {
+			size_t shared = 0;
+			while ( shared < previous.size() && shared < it->first.size() &&
+					previous[shared] == it->first[shared] )
+				++shared;
+
+			putVarint ( data, shared );
+			putVarint ( data, it->first.size() - shared );
+			data.append ( it->first, shared, string::npos );
+			putVarint ( data, it->second.score < 0 ?
+					( boost::uint64_t ( -( it->second.score + 1 ) ) << 1 ) | 1 :
+					boost::uint64_t ( it->second.score ) << 1 );
+			putVarint ( data, boost::uint64_t ( it->second.id ) );
+
+			previous = it->first;
+			bi.entries ++;
+		}
+
+		bi.bloom.assign ( ( bi.entries * BloomBitsPerEntry + 7 ) / 8, 0 );
+		for ( ; start != it; start++ )
+			bloomInsert ( bi.bloom, start->first );
+
+		bi.size = data.size();
+		out.write ( data.data(), data.size() );
+		offset += data.size();
+		blocks.push_back ( bi );
+	}
+
+	for ( unsigned int b = 0; b < blocks.size(); ++b ) {
+		string entry;
+		putVarint ( entry, blocks[b].offset );
+		putVarint ( entry, blocks[b].size );
+		putVarint ( entry, blocks[b].entries );
+		putVarint ( entry, blocks[b].first.size() );
+		entry += blocks[b].first;
+		putVarint ( entry, blocks[b].bloom.size() );
+		entry.append ( blocks[b].bloom.begin(), blocks[b].bloom.end() );
+		out.write ( entry.data(), entry.size() );
+	}
+
+	memcpy ( header.magic, "SCCF", 4 );
+	header.version = ColdVersion;
+	header.blocks = blocks.size();
+	header.next_id = next_id;
+	header.entries = cold.size();
+	header.index_offset = offset;
+
+	out.seekp ( 0 );
+	out.write ( reinterpret_cast<const char*> ( &header ), sizeof ( header ) );
+	out.close ();
+
+	return ! out.fail();
+}
+
+bool ColdFeatures::Open ( const string& segment_file, size_t cache_bytes )
+// read the block index of a segment file; blocks are read on demand
+{
+	boost::mutex::scoped_lock held ( lock );
+
+	CacheBytes = cache_bytes;
+	segment.open ( segment_file.c_str(), ios::in | ios::binary );
+
+	ColdHeader header;
+	if ( ! segment.read ( reinterpret_cast<char*> ( &header ),
+						  sizeof ( header ) ) ||
+			memcmp ( header.magic, "SCCF", 4 ) != 0 ||
+			header.version != ColdVersion ) {
+		error_msg = "Failed to open cold features file.";
+		return false;
+	}
+
+	segment.seekg ( 0, ios::end );
+	boost::uint64_t end = segment.tellg();
+
+	// every index entry takes at least 5 bytes
+	if ( header.index_offset < sizeof ( header ) ||
+			header.index_offset > end ||
+			header.blocks > ( end - header.index_offset ) / 5 ) {
+		error_msg = "Corrupt cold features header.";
+		return false;
+	}
+
+	string data ( end - header.index_offset, '\0' );
+	segment.seekg ( header.index_offset );
+	if ( ! data.empty() && ! segment.read ( &data[0], data.size() ) ) {
+		error_msg = "Failed to read cold features index.";
+		return false;
+	}
+
+	size_t pos = 0;
+	index.resize ( header.blocks );
+	for ( unsigned int b = 0; b < header.blocks; ++b ) {
+		boost::uint64_t offset, size, entries, length, bloom_size;
+
+		// blocks lie between header and index; every entry takes at
+		// least 4 bytes
+		bool ok = getVarint ( data, pos, offset ) &&
+				  getVarint ( data, pos, size ) &&
+				  getVarint ( data, pos, entries ) &&
+				  getVarint ( data, pos, length ) &&
+				  offset >= sizeof ( header ) &&
+				  size <= header.index_offset &&
+				  offset <= header.index_offset - size &&
+				  entries <= size / 4 &&
+				  length <= data.size() - pos;
+		if ( ok ) {
+			index[b].first.assign ( data, pos, length );
+			pos += length;
+			ok = getVarint ( data, pos, bloom_size ) &&
+				 bloom_size <= data.size() - pos &&
+				 ( bloom_size > 0 || entries == 0 );
+		}
+		if ( ! ok ) {
+			index.clear();
+			error_msg = "Corrupt cold features index.";
+			return false;
+		}
+
+		index[b].offset = offset;
+		index[b].size = size;
+		index[b].entries = entries;
+		index[b].bloom.assign ( data.begin() + pos,
+								data.begin() + pos + bloom_size );
+		pos += bloom_size;
+	}
+
+	next_id = header.next_id;
+	return true;
+}
+
+bool ColdFeatures::Find ( const string& phrase, FeatureScores& fs )
+// look up phrase; return false if it is not in the segment
+{
+	lookups.fetch_add ( 1, boost::memory_order_relaxed );
+	if ( index.empty() || phrase < index[0].first )
+		return false;
+
+	// the block index and Bloom filters are immutable once opened
+	unsigned int b = 0, e = index.size();
+	while ( e - b > 1 ) {
+		unsigned int m = ( b + e ) / 2;
+		if ( phrase < index[m].first ) e = m;
+		else b = m;
+	}
+	if ( ! bloomContains ( index[b].bloom, phrase ) ) {
+		bloom_rejects.fetch_add ( 1, boost::memory_order_relaxed );
+		return false;
+	}
+
+	// only the block cache and the file need the lock
+	boost::mutex::scoped_lock held ( lock );
+
+	Block* block = loadBlock ( b );
+	if ( ! block )
+		return false;
+
+	vector<string>::const_iterator it =
+		lower_bound ( block->phrases.begin(), block->phrases.end(), phrase );
+	if ( it == block->phrases.end() || *it != phrase )
+		return false;
+
+	fs = block->scores[ it - block->phrases.begin() ];
+	hits.fetch_add ( 1, boost::memory_order_relaxed );
+
+	return true;
+}
+
+bool ColdFeatures::readBlock ( unsigned int block, FeaturesTable& entries )
+// add all features of a block to entries, bypassing the cache
+{
+	boost::mutex::scoped_lock held ( lock );
+
+	Block decoded;
+	if ( block >= index.size() || ! decodeBlock ( block, decoded ) )
+		return false;
+
+	for ( unsigned int i = 0; i < decoded.phrases.size(); ++i )
+		entries[ decoded.phrases[i] ] = decoded.scores[i];
+
+	return true;
+}
+
+ColdFeatures::Block* ColdFeatures::loadBlock ( unsigned int block )
+// return cached block, reading it and evicting least recently used blocks
+// as needed; called with lock held
+{
+	map<unsigned int,Block>::iterator it = cache.find ( block );
+	if ( it != cache.end() ) {
+		cache_hits.fetch_add ( 1, boost::memory_order_relaxed );
+		lru.splice ( lru.begin(), lru, it->second.lru );
+		return &it->second;
+	}
+
+	Block decoded;
+	if ( ! decodeBlock ( block, decoded ) )
+		return NULL;
+	block_loads.fetch_add ( 1, boost::memory_order_relaxed );
+
+	// the newest block is always kept, even past the cache budget
+	while ( ! lru.empty() && cached_bytes + decoded.bytes > CacheBytes ) {
+		map<unsigned int,Block>::iterator oldest = cache.find ( lru.back() );
+		cached_bytes -= oldest->second.bytes;
+		cache.erase ( oldest );
+		lru.pop_back ();
+	}
+
+	it = cache.insert ( make_pair ( block, Block() ) ).first;
+	it->second.phrases.swap ( decoded.phrases );
+	it->second.scores.swap ( decoded.scores );
+	it->second.bytes = decoded.bytes;
+	lru.push_front ( block );
+	it->second.lru = lru.begin();
+	cached_bytes += decoded.bytes;
+
+	return &it->second;
+}
+
+bool ColdFeatures::decodeBlock ( unsigned int block, Block& decoded )
+// read and decode a block from disk; called with lock held
+{
+	const BlockIndex& bi = index[block];
+
+	string data ( bi.size, '\0' );
+	segment.clear ();
+	segment.seekg ( bi.offset );
+	if ( bi.size > 0 && ! segment.read ( &data[0], bi.size ) ) {
+		error_msg = "Failed to read cold features block.";
+		return false;
+	}
+
+	decoded.phrases.reserve ( bi.entries );
+	decoded.scores.reserve ( bi.entries );
+	decoded.bytes = sizeof ( Block );
+
+	size_t pos = 0;
+	string phrase;
+	for ( unsigned int i = 0; i < bi.entries; ++i ) {
+		boost::uint64_t shared, length, score, id;
+		if ( ! getVarint ( data, pos, shared ) ||
+			 ! getVarint ( data, pos, length ) ||
+			 shared > phrase.size() || pos + length > data.size() ) {
+			error_msg = "Corrupt cold features block.";
+			return false;
+		}
+		phrase.erase ( shared );
+		phrase.append ( data, pos, length );
+		pos += length;
+
+		if ( ! getVarint ( data, pos, score ) ||
+			 ! getVarint ( data, pos, id ) ) {
+			error_msg = "Corrupt cold features block.";
+			return false;
+		}
+
+		FeatureScores fs;
+		fs.score = ( score & 1 ) ? -int ( score >> 1 ) - 1 : int ( score >> 1 );
+		fs.relevance = abs ( fs.score );
+		fs.id = int ( id );
+
+		decoded.phrases.push_back ( phrase );
+		decoded.scores.push_back ( fs );
+		decoded.bytes += sizeof ( string ) + phrase.size() +
+						 sizeof ( FeatureScores );
+	}
+
+	return true;
+}
+
+bool ColdFeatures::bloomContains ( const vector<unsigned char>& bloom,
+		const string& phrase )
+{
+	if ( bloom.empty() )
+		return false;
+
+	boost::uint64_t h = hashPhrase ( phrase );
+	boost::uint32_t h1 = h, h2 = h >> 32;
+	size_t bits = bloom.size() * 8;
+
+	for ( unsigned int k = 0; k < BloomHashes; ++k ) {
+		size_t bit = ( h1 + k * h2 ) % bits;
+		if ( ! ( bloom[ bit / 8 ] & ( 1 << ( bit % 8 ) ) ) )
+			return false;
+	}
+	return true;
+}
+
+void ColdFeatures::bloomInsert ( vector<unsigned char>& bloom,
+		const string& phrase )
+{
+	boost::uint64_t h = hashPhrase ( phrase );
+	boost::uint32_t h1 = h, h2 = h >> 32;
+	size_t bits = bloom.size() * 8;
+
+	for ( unsigned int k = 0; k < BloomHashes; ++k ) {
+		size_t bit = ( h1 + k * h2 ) % bits;
+		bloom[ bit / 8 ] |= ( 1 << ( bit % 8 ) );
+	}
+}
+
+unsigned int ColdFeatures::getBlocks () const
+{
+	return index.size();
+}
+
+int ColdFeatures::getNextId () const
+{
+	return next_id;
+}
+
+size_t ColdFeatures::getCacheBytes () const
+{
+	boost::mutex::scoped_lock held ( lock );
+	return cached_bytes;
+}
+
+ColdCounters ColdFeatures::getCounters () const
+{
+	ColdCounters counters;
+	counters.lookups = lookups.load ( boost::memory_order_relaxed );
+	counters.bloom_rejects = bloom_rejects.load ( boost::memory_order_relaxed );
+	counters.cache_hits = cache_hits.load ( boost::memory_order_relaxed );
+	counters.block_loads = block_loads.load ( boost::memory_order_relaxed );
+	counters.hits = hits.load ( boost::memory_order_relaxed );
+	return counters;
+}
+
+string ColdFeatures::getErrorMsg () const
+{
+	boost::mutex::scoped_lock held ( lock );
+	return error_msg;
+}
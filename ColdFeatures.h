@@ -0,0 +1,116 @@
+/*
+ * ColdFeatures.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef COLDFEATURES_H_
+#define COLDFEATURES_H_
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <list>
+#include <map>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "SentimentClassifier.h"
+
+using namespace std;
+
+// Cold segment layout (native byte order):
+//
+//   header   magic "SCCF", version, blocks, entries, next feature id,
+//            offset of block index
+//   blocks   phrases in sorted order, front-coded: per entry varints of
+//            shared prefix length, suffix length, suffix bytes, zigzag
+//            score and id
+//   index    per block: offset, size, entries, first phrase and Bloom
+//            filter bits
+
+struct ColdCounters
+// data structure for counting lookups served by the cold tier
+{
+	ColdCounters();
+
+	unsigned long lookups;
+	// phrases looked up in the cold tier
+
+	unsigned long bloom_rejects;
+	// lookups answered by a block's Bloom filter without reading it
+
+	unsigned long cache_hits;
+	// lookups served from a cached block
+
+	unsigned long block_loads;
+	// blocks read from disk and decoded
+
+	unsigned long hits;
+	// lookups that found the phrase
+};
+
+class ColdFeatures {
+// sorted, block-compressed features on disk, read through a bounded cache
+public:
+	ColdFeatures ();
+	static bool Write ( const string& segment_file,
+						const FeaturesTable& cold, int next_id );
+	bool Open ( const string& segment_file, size_t cache_bytes );
+	bool Find ( const string& phrase, FeatureScores& fs );
+	bool readBlock ( unsigned int block, FeaturesTable& entries );
+
+	unsigned int getBlocks () const;
+	int getNextId () const;
+	size_t getCacheBytes () const;
+	ColdCounters getCounters () const;
+	string getErrorMsg () const;
+
+private:
+	struct BlockIndex {
+		boost::uint64_t offset;
+		boost::uint32_t size;
+		boost::uint32_t entries;
+		string first;
+		vector<unsigned char> bloom;
+	};
+
+	struct Block {
+		vector<string> phrases;
+		vector<FeatureScores> scores;
+		size_t bytes;
+		list<unsigned int>::iterator lru;
+	};
+
+	mutable boost::mutex lock;
+	ifstream segment;
+	vector<BlockIndex> index;
+	map<unsigned int,Block> cache;
+	list<unsigned int> lru;
+	// cached blocks, least recently used last
+
+	size_t CacheBytes;
+	size_t cached_bytes;
+	int next_id;
+	boost::atomic<unsigned long> lookups;
+	boost::atomic<unsigned long> bloom_rejects;
+	boost::atomic<unsigned long> cache_hits;
+	boost::atomic<unsigned long> block_loads;
+	boost::atomic<unsigned long> hits;
+	// counters are updated without the lock
+	string error_msg;
+
+	static const unsigned int BlockBytes = 4096;
+	static const unsigned int BloomBitsPerEntry = 10;
+	static const unsigned int BloomHashes = 4;
+
+	static bool bloomContains ( const vector<unsigned char>& bloom,
+								const string& phrase );
+	static void bloomInsert ( vector<unsigned char>& bloom,
+							  const string& phrase );
+	Block* loadBlock ( unsigned int block );
+	bool decodeBlock ( unsigned int block, Block& decoded );
+};
+
+#endif /* COLDFEATURES_H_ */
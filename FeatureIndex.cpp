@@ -0,0 +1,126 @@
+/*
+ * FeatureIndex.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "FeatureIndex.h"
+
+#include <string.h>
+
+static const boost::uint32_t EmptySlot = 0xffffffff;
+
+FeatureIndex::FeatureIndex ()
+	: region (), slots (NULL), phrases (NULL), mask (0)
+{}
+
+FeatureIndex::~FeatureIndex ()
+{
+	releaseRegion ( region );
+}
+
+bool FeatureIndex::Build ( const FeaturesTable& features, bool huge_pages,
+		int node )
+// copy features into a region placed on node (-1: anywhere), in huge pages
+// if asked; return false if the region cannot be allocated
+{
+	// at most half full, so probe runs stay short
+	boost::uint32_t capacity = 16;
+	while ( capacity < 2 * features.size() )
+		capacity *= 2;
+
+	size_t pool = 0;
+	for ( FeaturesTable::const_iterator it = features.begin();
+			it != features.end(); it++ )
+		pool += it->first.size();
+
+	PlacedRegion next;
+	if ( ! allocateRegion ( capacity * sizeof ( Slot ) + pool,
+							huge_pages, node, next ) )
+		return false;
+
+	// writing the region here places its pages on node
+	Slot* table = static_cast<Slot*> ( next.base );
+	char* text = static_cast<char*> ( next.base ) + capacity * sizeof ( Slot );
+
+	for ( boost::uint32_t s = 0; s < capacity; ++s ) {
+		memset ( &table[s], 0, sizeof ( Slot ) );
+		table[s].offset = EmptySlot;
+	}
+
+	boost::uint32_t offset = 0;
+	for ( FeaturesTable::const_iterator it = features.begin();
+			it != features.end(); it++ ) {
+		boost::uint32_t h = hashPhrase ( it->first.data(), it->first.size() );
+		boost::uint32_t s = h & ( capacity - 1 );
+		while ( table[s].offset != EmptySlot )
+			s = ( s + 1 ) & ( capacity - 1 );
+
+		table[s].hash = h;
+		table[s].offset = offset;
+		table[s].length = it->first.size();
+		table[s].score = it->second.score;
+		table[s].relevance = it->second.relevance;
+		table[s].id = it->second.id;
+
+		memcpy ( text + offset, it->first.data(), it->first.size() );
+		offset += it->first.size();
+	}
+
+	releaseRegion ( region );
+	region = next;
+	slots = table;
+	phrases = text;
+	mask = capacity - 1;
+
+	return true;
+}
+
+bool FeatureIndex::Find ( const string& phrase, FeatureScores& fs ) const
+// copy scores of phrase into fs; return false if phrase is not indexed
+{
+	if ( ! slots )
+		return false;
+
+	boost::uint32_t h = hashPhrase ( phrase.data(), phrase.size() );
+
+	for ( boost::uint32_t s = h & mask; slots[s].offset != EmptySlot;
+			s = ( s + 1 ) & mask ) {
+		const Slot& slot = slots[s];
+		if ( slot.hash == h && slot.length == phrase.size() &&
+				memcmp ( phrases + slot.offset, phrase.data(),
+						 slot.length ) == 0 ) {
+			fs.score = slot.score;
+			fs.relevance = slot.relevance;
+			fs.id = slot.id;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t FeatureIndex::getBytes () const
+{
+	return region.bytes;
+}
+
+const PlacedRegion& FeatureIndex::getRegion () const
+{
+	return region;
+}
+
+boost::uint32_t FeatureIndex::hashPhrase ( const char* phrase,
+		size_t length )
+// FNV-1a with a final mix, so low bits index slots well
+{
+	boost::uint32_t h = 2166136261U;
+	for ( size_t i = 0; i < length; ++i )
+		h = ( h ^ (unsigned char) phrase[i] ) * 16777619U;
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+
+	return h;
+}
@@ -0,0 +1,53 @@
+/*
+ * FeatureIndex.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef FEATUREINDEX_H_
+#define FEATUREINDEX_H_
+
+#include <string>
+#include <boost/cstdint.hpp>
+
+#include "NumaPlacement.h"
+#include "SentimentClassifier.h"
+
+using namespace std;
+
+class FeatureIndex {
+// immutable open-addressing hash table of features in one placed region:
+// slots, then phrase bytes. A lookup touches a slot or two and one phrase
+// instead of a chain of tree nodes spread over the heap.
+public:
+	FeatureIndex ();
+	~FeatureIndex ();
+	bool Build ( const FeaturesTable& features, bool huge_pages, int node );
+	bool Find ( const string& phrase, FeatureScores& fs ) const;
+
+	size_t getBytes () const;
+	const PlacedRegion& getRegion () const;
+
+private:
+	struct Slot {
+		boost::uint32_t hash;
+		boost::uint32_t offset;
+		boost::uint32_t length;
+		boost::int32_t score;
+		boost::int32_t relevance;
+		boost::int32_t id;
+	};
+
+	PlacedRegion region;
+	const Slot* slots;
+	const char* phrases;
+	boost::uint32_t mask;
+	// slots - 1; slots are a power of two
+
+	static boost::uint32_t hashPhrase ( const char* phrase, size_t length );
+
+	FeatureIndex ( const FeatureIndex& );
+	FeatureIndex& operator= ( const FeatureIndex& );
+};
+
+#endif /* FEATUREINDEX_H_ */
@@ -0,0 +1,286 @@
+/*
+ * NearDuplicateIndex.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "NearDuplicateIndex.h"
+#include "TextUtils.h"
+
+#include <ctype.h>
+
+static boost::uint64_t hashToken ( const string& token, unsigned int field )
+// FNV-1a over field and token, then mixed so every bit is balanced
+{
+	boost::uint64_t h = 14695981039346656037ULL;
+
+	h = ( h ^ field ) * 1099511628211ULL;
+	for ( unsigned int i = 0; i < token.size(); ++i )
+		h = ( h ^ (unsigned char) token[i] ) * 1099511628211ULL;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static unsigned int hammingDistance ( boost::uint64_t a, boost::uint64_t b )
+{
+	unsigned int d = 0;
+	for ( boost::uint64_t x = a ^ b; x; x &= x - 1 )
+		++d;
+	return d;
+}
+
+SimHash::SimHash ()
+	: separators (0), question_marks (0)
+{
+	for ( unsigned int i = 0; i < 64; ++i )
+		bits[i] = 0;
+}
+
+void SimHash::Add ( const string& content, unsigned int field )
+// add tokens of content, as normalizeContent sees them, and token bigrams
+{
+	// sentences are split and question marks counted once urls are
+	// removed, case-sensitively, from the raw text
+	for ( size_t i = 0; i < content.size(); ) {
+		size_t span = urlSpan ( content, i, false );
+		if ( span > 0 ) {
+			i += span;
+			continue;
+		}
+		char c = content[i++];
+		if ( c == '?' ) question_marks ++;
+		if ( c == ';' || c == '?' || c == '!' ) separators ++;
+	}
+
+	string token, previous;
+	for ( size_t i = 0; i <= content.size(); ) {
+		char c = ( i < content.size() ) ?
+			tolower ( (unsigned char) content[i] ) : ' ';
+
+		// hash and at tags are replaced by a space, urls by nothing
+		if ( ( c == '#' || c == '@' ) && ( i == 0 || content[i-1] == ' ' ) ) {
+			while ( i < content.size() &&
+					! isspace ( (unsigned char) content[i] ) )
+				++i;
+			c = ' ';
+		} else {
+			size_t span = ( i < content.size() ) ?
+				urlSpan ( content, i, true ) : 0;
+			if ( span > 0 ) {
+				i += span;
+				continue;
+			}
+			++i;
+		}
+
+		// symbols separate tokens; digit runs fold to one placeholder
+		if ( isdigit ( (unsigned char) c ) ) {
+			if ( token.empty() || token[token.size()-1] != '0' )
+				token += '0';
+		} else if ( ( c >= 'a' && c <= 'z' ) || c == '\'' ) {
+			token += c;
+		} else if ( ! token.empty() ) {
+			addToken ( token, field );
+			if ( ! previous.empty() )
+				addToken ( previous + " " + token, field );
+			previous.swap ( token );
+			token.clear();
+		}
+	}
+}
+
+void SimHash::addToken ( const string& token, unsigned int field )
+{
+	boost::uint64_t h = hashToken ( token, field );
+	for ( unsigned int i = 0; i < 64; ++i )
+		bits[i] += ( ( h >> i ) & 1 ) ? 1 : -1;
+}
+
+boost::uint64_t SimHash::Value () const
+{
+	boost::uint64_t fp = 0;
+	for ( unsigned int i = 0; i < 64; ++i )
+		if ( bits[i] > 0 )
+			fp |= boost::uint64_t ( 1 ) << i;
+
+	// equal counts keep distances; different counts scatter fingerprints
+	if ( separators > 0 || question_marks > 0 ) {
+		string counts;
+		for ( unsigned int n = separators; n > 0; n /= 10 )
+			counts += char ( '0' + n % 10 );
+		counts += '/';
+		for ( unsigned int n = question_marks; n > 0; n /= 10 )
+			counts += char ( '0' + n % 10 );
+		fp ^= hashToken ( counts, 0 );
+	}
+
+	return fp;
+}
+
+NearDuplicateIndex::NearDuplicateIndex ( unsigned int max_distance,
+		size_t max_bytes )
+	: MaxDistance ( max_distance ), MaxBytes ( max_bytes ), lock (),
+	  entries (), first_seq (0), bands (), generation (0), bytes (0),
+	  checked (0), inherited (0)
+{
+	// at least one band bit per band
+	if ( MaxDistance > 63 ) MaxDistance = 63;
+	bands.resize ( MaxDistance + 1 );
+}
+
+boost::uint64_t NearDuplicateIndex::bandKey ( boost::uint64_t fp,
+		unsigned int band ) const
+// bits of band in fp, tagged with the band number
+{
+	unsigned int n = bands.size();
+	unsigned int lo = 64 * band / n;
+	unsigned int hi = 64 * ( band + 1 ) / n;
+
+	boost::uint64_t mask = ( hi - lo == 64 ) ? ~boost::uint64_t ( 0 ) :
+		( ( boost::uint64_t ( 1 ) << ( hi - lo ) ) - 1 ) << lo;
+
+	return fp & mask;
+}
+
+bool NearDuplicateIndex::Find ( boost::uint64_t fp, unsigned int gen,
+		CDecision& cd )
+// copy the decision of the nearest stored fingerprint within MaxDistance
+// bits into cd; return false if there is none
+{
+	boost::mutex::scoped_lock held ( lock );
+
+	checked ++;
+	if ( gen != generation )
+		return false;
+
+	const Entry* best = NULL;
+	unsigned int best_distance = MaxDistance + 1;
+
+	for ( unsigned int b = 0; b < bands.size() && best_distance > 0; ++b ) {
+		pair<BandTable::const_iterator, BandTable::const_iterator> range =
+			bands[b].equal_range ( bandKey ( fp, b ) );
+
+		for ( BandTable::const_iterator it = range.first;
+				it != range.second; it++ ) {
+			const Entry& e = entries[ it->second - first_seq ];
+			unsigned int d = hammingDistance ( fp, e.fp );
+			if ( d < best_distance ) {
+				best = &e;
+				best_distance = d;
+			}
+		}
+	}
+
+	if ( ! best )
+		return false;
+
+	cd = best->cd;
+	cd.inherited = true;
+	inherited ++;
+
+	return true;
+}
+
+void NearDuplicateIndex::Insert ( boost::uint64_t fp, unsigned int gen,
+		const CDecision& cd )
+// remember decision of fingerprint, evicting the oldest entries past MaxBytes
+{
+	boost::mutex::scoped_lock held ( lock );
+
+	// decisions made under an older model or options are never reused
+	if ( gen != generation ) {
+		clearEntries ();
+		generation = gen;
+	}
+
+	Entry e;
+	e.fp = fp;
+	e.cd = cd;
+	e.cd.inherited = false;
+	e.bytes = sizeof ( Entry ) + cd.content.size() +
+		cd.feature_scores.size() * sizeof ( int ) +
+		bands.size() * 4 * sizeof ( boost::uint64_t );
+	for ( unsigned int i = 0; i < cd.features.size(); ++i )
+		e.bytes += sizeof ( string ) + cd.features[i].size();
+
+	if ( e.bytes > MaxBytes )
+		return;
+
+	while ( bytes + e.bytes > MaxBytes )
+		evictOldest ();
+
+	boost::uint64_t seq = first_seq + entries.size();
+	entries.push_back ( e );
+	bytes += e.bytes;
+
+	for ( unsigned int b = 0; b < bands.size(); ++b )
+		bands[b].insert ( make_pair ( bandKey ( fp, b ), seq ) );
+}
+
+void NearDuplicateIndex::Clear ()
+{
+	boost::mutex::scoped_lock held ( lock );
+	clearEntries ();
+}
+
+void NearDuplicateIndex::clearEntries ()
+{
+	entries.clear ();
+	for ( unsigned int b = 0; b < bands.size(); ++b )
+		bands[b].clear ();
+	first_seq = 0;
+	bytes = 0;
+}
+
+void NearDuplicateIndex::evictOldest ()
+{
+	const Entry& e = entries.front();
+
+	for ( unsigned int b = 0; b < bands.size(); ++b ) {
+		pair<BandTable::iterator, BandTable::iterator> range =
+			bands[b].equal_range ( bandKey ( e.fp, b ) );
+		for ( BandTable::iterator it = range.first; it != range.second; it++ )
+			if ( it->second == first_seq ) {
+				bands[b].erase ( it );
+				break;
+			}
+	}
+
+	bytes -= e.bytes;
+	entries.pop_front ();
+	first_seq ++;
+}
+
+unsigned int NearDuplicateIndex::getMaxDistance () const
+{
+	return MaxDistance;
+}
+
+size_t NearDuplicateIndex::getMaxBytes () const
+{
+	return MaxBytes;
+}
+
+size_t NearDuplicateIndex::getBytes () const
+{
+	boost::mutex::scoped_lock held ( lock );
+	return bytes;
+}
+
+unsigned long NearDuplicateIndex::getChecked () const
+{
+	boost::mutex::scoped_lock held ( lock );
+	return checked;
+}
+
+unsigned long NearDuplicateIndex::getInherited () const
+{
+	boost::mutex::scoped_lock held ( lock );
+	return inherited;
+}
@@ -0,0 +1,88 @@
+/*
+ * NearDuplicateIndex.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef NEARDUPLICATEINDEX_H_
+#define NEARDUPLICATEINDEX_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "SentimentClassifier.h"
+
+using namespace std;
+
+class SimHash {
+// 64-bit SimHash of the tokens normalizeContent would keep and their
+// bigrams, computed over raw text: lower-cased, #/@ tags and http: urls
+// dropped, and digits folded so templated variants hash alike. Sentence
+// separators and question marks outside urls change decisions outright,
+// so their counts are mixed into every bit: only documents with equal
+// counts can be near each other
+public:
+	SimHash ();
+	void Add ( const string& content, unsigned int field );
+	boost::uint64_t Value () const;
+
+private:
+	int bits[64];
+	unsigned int separators;
+	unsigned int question_marks;
+	void addToken ( const string& token, unsigned int field );
+};
+
+class NearDuplicateIndex {
+// bounded index of recent fingerprints and their decisions; fingerprints
+// are split into MaxDistance + 1 bands so any fingerprint within
+// MaxDistance bits of a stored one shares at least one band with it
+public:
+	NearDuplicateIndex ( unsigned int max_distance, size_t max_bytes );
+	bool Find ( boost::uint64_t fp, unsigned int generation, CDecision& cd );
+	void Insert ( boost::uint64_t fp, unsigned int generation,
+				  const CDecision& cd );
+	void Clear ();
+
+	unsigned int getMaxDistance () const;
+	size_t getMaxBytes () const;
+	size_t getBytes () const;
+	unsigned long getChecked () const;
+	unsigned long getInherited () const;
+
+private:
+	struct Entry {
+		boost::uint64_t fp;
+		size_t bytes;
+		CDecision cd;
+	};
+
+	typedef boost::unordered_multimap<boost::uint64_t,boost::uint64_t>
+		BandTable;
+
+	unsigned int MaxDistance;
+	size_t MaxBytes;
+
+	mutable boost::mutex lock;
+	deque<Entry> entries;
+	// entries in insertion order; entries[i] has sequence first_seq + i
+
+	boost::uint64_t first_seq;
+	vector<BandTable> bands;
+	// band value -> sequence of entries having it
+
+	unsigned int generation;
+	size_t bytes;
+	unsigned long checked;
+	unsigned long inherited;
+
+	boost::uint64_t bandKey ( boost::uint64_t fp, unsigned int band ) const;
+	void evictOldest ();
+	void clearEntries ();
+};
+
+#endif /* NEARDUPLICATEINDEX_H_ */
@@ -0,0 +1,191 @@
+/*
+ * NumaPlacement.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "NumaPlacement.h"
+
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <boost/thread/tss.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+static const size_t HugePageBytes = 2 * 1024 * 1024;
+
+// node each thread was bound to by bindThreadToNode
+static boost::thread_specific_ptr<int> bound_node;
+
+// mbind policy, as in linux/mempolicy.h; libnuma is not required
+static const int PreferredPolicy = 1;
+
+PlacedRegion::PlacedRegion ()
+	: base(NULL), bytes(0), huge_pages(false), transparent(false), node(-1),
+	  mapped(false)
+{}
+
+bool allocateRegion ( size_t bytes, bool huge_pages, int node,
+		PlacedRegion& region )
+// allocate a region of at least bytes; huge pages and node placement are
+// best effort, and region records what was obtained. Pages are placed when
+// first written, so fill the region from any thread after allocating it
+{
+	region = PlacedRegion ();
+
+#ifdef __linux__
+	size_t page = sysconf ( _SC_PAGESIZE );
+	size_t rounded = huge_pages ?
+		( bytes + HugePageBytes - 1 ) / HugePageBytes * HugePageBytes :
+		( bytes + page - 1 ) / page * page;
+	if ( rounded == 0 )
+		rounded = page;
+
+	void* base = MAP_FAILED;
+
+	// reserved huge pages first, then transparent huge pages
+	if ( huge_pages ) {
+		base = mmap ( NULL, rounded, PROT_READ | PROT_WRITE,
+					  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+		region.huge_pages = ( base != MAP_FAILED );
+	}
+	if ( base == MAP_FAILED )
+		base = mmap ( NULL, rounded, PROT_READ | PROT_WRITE,
+					  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( base == MAP_FAILED )
+		return false;
+
+	if ( huge_pages && ! region.huge_pages )
+		region.transparent =
+			( madvise ( base, rounded, MADV_HUGEPAGE ) == 0 );
+
+	if ( node >= 0 && node < int ( 8 * sizeof ( unsigned long ) ) ) {
+		unsigned long mask = 1UL << node;
+		if ( syscall ( SYS_mbind, base, rounded, PreferredPolicy, &mask,
+					   8 * sizeof ( mask ), 0 ) == 0 )
+			region.node = node;
+	}
+
+	region.base = base;
+	region.bytes = rounded;
+	region.mapped = true;
+#else
+	region.base = malloc ( bytes > 0 ? bytes : 1 );
+	region.bytes = bytes;
+	if ( ! region.base )
+		return false;
+#endif
+
+	return true;
+}
+
+void releaseRegion ( PlacedRegion& region )
+{
+	if ( ! region.base )
+		return;
+
+#ifdef __linux__
+	if ( region.mapped )
+		munmap ( region.base, region.bytes );
+	else
+#endif
+		free ( region.base );
+
+	region = PlacedRegion ();
+}
+
+unsigned int numaNodes ()
+// number of NUMA nodes with CPUs or memory, at least 1
+{
+	unsigned int nodes = 1;
+
+	ifstream fs ( "/sys/devices/system/node/online" );
+	string online;
+	if ( fs >> online ) {
+		// list of ranges such as "0-1" or "0,2"; nodes are numbered densely
+		string::size_type last = online.find_last_of ( ",-" );
+		int highest = atoi ( online.c_str() +
+							 ( last == string::npos ? 0 : last + 1 ) );
+		nodes = highest + 1;
+	}
+
+	return nodes;
+}
+
+bool nodeCpus ( int node, vector<int>& cpus )
+// list CPUs of node; return false if the node is unknown
+{
+	cpus.clear();
+
+	stringstream path;
+	path << "/sys/devices/system/node/node" << node << "/cpulist";
+
+	ifstream fs ( path.str().c_str() );
+	string list;
+	if ( ! ( fs >> list ) )
+		return false;
+
+	// ranges such as "0-3,8-11"
+	stringstream ranges ( list );
+	string range;
+	while ( getline ( ranges, range, ',' ) ) {
+		string::size_type dash = range.find ( '-' );
+		int first = atoi ( range.c_str() );
+		int last = ( dash == string::npos ) ?
+			first : atoi ( range.c_str() + dash + 1 );
+		for ( int cpu = first; cpu <= last; ++cpu )
+			cpus.push_back ( cpu );
+	}
+
+	return ! cpus.empty();
+}
+
+int currentNode ()
+// NUMA node of the CPU running the calling thread; 0 if unknown
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned int cpu = 0, node = 0;
+	if ( syscall ( SYS_getcpu, &cpu, &node, NULL ) == 0 )
+		return node;
+#endif
+	return 0;
+}
+
+bool bindThreadToNode ( int node )
+// restrict the calling thread to the CPUs of node
+{
+#ifdef __linux__
+	vector<int> cpus;
+	if ( ! nodeCpus ( node, cpus ) )
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO ( &set );
+	for ( unsigned int i = 0; i < cpus.size(); ++i )
+		if ( cpus[i] < CPU_SETSIZE )
+			CPU_SET ( cpus[i], &set );
+
+	if ( pthread_setaffinity_np ( pthread_self(), sizeof ( set ), &set ) != 0 )
+		return false;
+
+	bound_node.reset ( new int ( node ) );
+	return true;
+#else
+	return false;
+#endif
+}
+
+int boundNode ()
+// node the calling thread is bound to; -1 if it may run on any node
+{
+	int* node = bound_node.get();
+	return node ? *node : -1;
+}
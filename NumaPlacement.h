@@ -0,0 +1,53 @@
+/*
+ * NumaPlacement.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef NUMAPLACEMENT_H_
+#define NUMAPLACEMENT_H_
+
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+// Memory regions for read-mostly model data, optionally backed by 2 MB
+// pages and placed on one NUMA node. Linux only; elsewhere regions are
+// plain heap memory and the machine has a single node.
+
+struct PlacedRegion
+// data structure describing an allocated region
+{
+	PlacedRegion();
+
+	void* base;
+	// start of region; NULL if not allocated
+
+	size_t bytes;
+	// size of region, rounded up to whole pages
+
+	bool huge_pages;
+	// backed by reserved (hugetlbfs) 2 MB pages
+
+	bool transparent;
+	// transparent huge pages were requested for the region instead
+
+	int node;
+	// NUMA node the region is placed on; -1 if not placed
+
+	bool mapped;
+	// region came from mmap rather than the heap
+};
+
+bool allocateRegion ( size_t bytes, bool huge_pages, int node,
+					  PlacedRegion& region );
+void releaseRegion ( PlacedRegion& region );
+
+unsigned int numaNodes ();
+bool nodeCpus ( int node, vector<int>& cpus );
+int currentNode ();
+bool bindThreadToNode ( int node );
+int boundNode ();
+
+#endif /* NUMAPLACEMENT_H_ */
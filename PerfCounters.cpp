@@ -0,0 +1,108 @@
+/*
+ * PerfCounters.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "PerfCounters.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+PerfCounters::PerfCounters ()
+{
+	for ( int e = 0; e < Events; ++e ) {
+		fds[e] = -1;
+
+#ifdef __linux__
+		// node misses are loads served by another node's memory
+		static const unsigned long long configs[ Events ] = {
+			PERF_COUNT_HW_CACHE_DTLB |
+				( PERF_COUNT_HW_CACHE_OP_READ << 8 ) |
+				( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ),
+			PERF_COUNT_HW_CACHE_NODE |
+				( PERF_COUNT_HW_CACHE_OP_READ << 8 ) |
+				( PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16 ),
+			PERF_COUNT_HW_CACHE_NODE |
+				( PERF_COUNT_HW_CACHE_OP_READ << 8 ) |
+				( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 )
+		};
+
+		struct perf_event_attr attr;
+		memset ( &attr, 0, sizeof ( attr ) );
+		attr.size = sizeof ( attr );
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = configs[e];
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		fds[e] = syscall ( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+#endif
+	}
+}
+
+PerfCounters::~PerfCounters ()
+{
+#ifdef __linux__
+	for ( int e = 0; e < Events; ++e )
+		if ( fds[e] >= 0 )
+			close ( fds[e] );
+#endif
+}
+
+void PerfCounters::Start ()
+// reset and enable all available events
+{
+#ifdef __linux__
+	for ( int e = 0; e < Events; ++e )
+		if ( fds[e] >= 0 ) {
+			ioctl ( fds[e], PERF_EVENT_IOC_RESET, 0 );
+			ioctl ( fds[e], PERF_EVENT_IOC_ENABLE, 0 );
+		}
+#endif
+}
+
+void PerfCounters::Stop ()
+{
+#ifdef __linux__
+	for ( int e = 0; e < Events; ++e )
+		if ( fds[e] >= 0 )
+			ioctl ( fds[e], PERF_EVENT_IOC_DISABLE, 0 );
+#endif
+}
+
+bool PerfCounters::Available ( Event e ) const
+{
+	return fds[e] >= 0;
+}
+
+unsigned long long PerfCounters::getCount ( Event e ) const
+// count since Start, including threads created after construction
+{
+	unsigned long long count = 0;
+
+#ifdef __linux__
+	if ( fds[e] < 0 ||
+			read ( fds[e], &count, sizeof ( count ) ) != sizeof ( count ) )
+		count = 0;
+#endif
+
+	return count;
+}
+
+const char* PerfCounters::getName ( Event e )
+{
+	static const char* names[ Events ] = {
+		"dTLB-load-misses", "node-loads", "node-load-misses"
+	};
+
+	return names[e];
+}
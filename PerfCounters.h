@@ -0,0 +1,38 @@
+/*
+ * PerfCounters.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+class PerfCounters {
+// hardware event counts of this process and threads it creates after
+// construction (Linux perf events); events the host does not offer read
+// as unavailable
+public:
+	enum Event {
+		DtlbLoadMisses,
+		NodeLoads,
+		NodeLoadMisses,
+		Events
+	};
+
+	PerfCounters ();
+	~PerfCounters ();
+	void Start ();
+	void Stop ();
+
+	bool Available ( Event e ) const;
+	unsigned long long getCount ( Event e ) const;
+	static const char* getName ( Event e );
+
+private:
+	int fds[ Events ];
+
+	PerfCounters ( const PerfCounters& );
+	PerfCounters& operator= ( const PerfCounters& );
+};
+
+#endif /* PERFCOUNTERS_H_ */
@@ -0,0 +1,178 @@
+/*
+ * SentimentAggregator.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "SentimentAggregator.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <limits>
+#include <boost/functional/hash.hpp>
+
+WindowSummary::WindowSummary ()
+	: entity(), start(0), end(0), negative(0), neutral(0), positive(0),
+	  undecided(0), raw_score(0), confidence(0), top_features()
+{}
+
+bool WindowKey::operator== ( const WindowKey& wk ) const
+{
+	return start == wk.start && entity == wk.entity;
+}
+
+size_t hash_value ( const WindowKey& wk )
+{
+	size_t seed = boost::hash_value ( wk.entity );
+	boost::hash_combine ( seed, wk.start );
+	return seed;
+}
+
+static bool scoreMagnitudeGreater ( const pair<string,int>& a,
+		const pair<string,int>& b )
+// order features by decreasing |score|, then by phrase
+{
+	if ( abs ( a.second ) != abs ( b.second ) )
+		return abs ( a.second ) > abs ( b.second );
+	return a.first < b.first;
+}
+
+SentimentAggregator::SentimentAggregator ( unsigned int window_size,
+		unsigned int window_slide, unsigned int top_features )
+	: WindowSize (window_size), WindowSlide (window_slide),
+	  TopFeatures (top_features),
+	  watermark ( numeric_limits<boost::int64_t>::min() ), dropped_late (0),
+	  windows (), closing ()
+{
+	// a window slide of 0 or beyond the window size means tumbling windows
+	if ( WindowSize == 0 ) WindowSize = 1;
+	if ( WindowSlide == 0 || WindowSlide > WindowSize )
+		WindowSlide = WindowSize;
+}
+
+bool SentimentAggregator::Add ( const string& entity,
+		boost::int64_t timestamp, const CDecision& cd,
+		vector<WindowSummary>& closed )
+// add a decision to every window of entity covering timestamp; windows that
+// end at or before the newest timestamp seen are appended to closed.
+// return false if the decision arrived after all its windows closed.
+{
+	if ( timestamp > watermark ) {
+		watermark = timestamp;
+		closeWindows ( watermark, closed );
+	}
+
+	// latest window start at or before timestamp
+	boost::int64_t slide = WindowSlide;
+	boost::int64_t start = timestamp - ( ( timestamp % slide ) + slide ) % slide;
+
+	bool added = false;
+	for ( ; start > timestamp - boost::int64_t ( WindowSize ); start -= slide ) {
+
+		if ( start + boost::int64_t ( WindowSize ) <= watermark )
+			continue;
+
+		WindowKey wk;
+		wk.entity = entity;
+		wk.start = start;
+
+		WindowsTable::iterator it = windows.find ( wk );
+		if ( it == windows.end() ) {
+			it = windows.insert ( make_pair ( wk, WindowStats() ) ).first;
+			it->second.summary.entity = entity;
+			it->second.summary.start = start;
+			it->second.summary.end = start + WindowSize;
+			closing[ start ].push_back ( entity );
+		}
+
+		WindowSummary& ws = it->second.summary;
+		if ( cd.confidence < 0 ) {
+			ws.undecided ++;
+		} else {
+			if ( cd.decision < 0 ) ws.negative ++;
+			else if ( cd.decision > 0 ) ws.positive ++;
+			else ws.neutral ++;
+
+			ws.raw_score += cd.raw_score;
+			ws.confidence += cd.confidence;
+		}
+
+		if ( TopFeatures > 0 )
+			for ( unsigned int i = 0;
+					i < cd.features.size() && i < cd.feature_scores.size(); ++i )
+				it->second.features[ cd.features[i] ] += cd.feature_scores[i];
+
+		added = true;
+	}
+
+	if ( ! added ) dropped_late ++;
+
+	return added;
+}
+
+void SentimentAggregator::Flush ( vector<WindowSummary>& closed )
+// close every open window, e.g. at end of input
+{
+	while ( ! closing.empty() )
+		closeOldest ( closed );
+}
+
+void SentimentAggregator::closeWindows ( boost::int64_t until,
+		vector<WindowSummary>& closed )
+// close windows ending at or before until
+{
+	while ( ! closing.empty() &&
+			closing.begin()->first + boost::int64_t ( WindowSize ) <= until )
+		closeOldest ( closed );
+}
+
+void SentimentAggregator::closeOldest ( vector<WindowSummary>& closed )
+// emit and forget all windows sharing the earliest open start
+{
+	WindowsQueue::iterator q = closing.begin();
+	for ( unsigned int i = 0; i < q->second.size(); ++i ) {
+		WindowKey wk;
+		wk.entity = q->second[i];
+		wk.start = q->first;
+
+		WindowsTable::iterator it = windows.find ( wk );
+		emitWindow ( it->second, closed );
+		windows.erase ( it );
+	}
+	closing.erase ( q );
+}
+
+void SentimentAggregator::emitWindow ( WindowStats& ws,
+		vector<WindowSummary>& closed )
+{
+	vector< pair<string,int> > ranked ( ws.features.begin(),
+										ws.features.end() );
+	unsigned int n = min ( (unsigned int) ranked.size(), TopFeatures );
+
+	partial_sort ( ranked.begin(), ranked.begin() + n, ranked.end(),
+				   scoreMagnitudeGreater );
+	ranked.resize ( n );
+
+	closed.push_back ( ws.summary );
+	closed.back().top_features.swap ( ranked );
+}
+
+unsigned int SentimentAggregator::getWindowSize () const
+{
+	return WindowSize;
+}
+
+unsigned int SentimentAggregator::getWindowSlide () const
+{
+	return WindowSlide;
+}
+
+unsigned int SentimentAggregator::getActiveWindows () const
+{
+	return windows.size();
+}
+
+unsigned int SentimentAggregator::getDroppedLate () const
+{
+	return dropped_late;
+}
@@ -0,0 +1,110 @@
+/*
+ * SentimentAggregator.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef SENTIMENTAGGREGATOR_H_
+#define SENTIMENTAGGREGATOR_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "SentimentClassifier.h"
+
+using namespace std;
+
+struct WindowSummary
+// data structure for the sentiment of one entity over one time window
+{
+	WindowSummary();
+
+	string entity;
+	// aggregation key, e.g. brand
+
+	boost::int64_t start;
+	// first second covered by the window
+
+	boost::int64_t end;
+	// first second after the window
+
+	int negative;
+	// number of decisions of -1
+
+	int neutral;
+	// number of decisions of 0
+
+	int positive;
+	// number of decisions of +1
+
+	int undecided;
+	// number of documents for which no decision could be reached
+
+	boost::int64_t raw_score;
+	// sum of raw_score over decided documents
+
+	boost::int64_t confidence;
+	// sum of confidence over decided documents
+
+	vector< pair<string,int> > top_features;
+	// features with the largest summed |score|, with summed score
+};
+
+struct WindowKey
+// data structure identifying an open window
+{
+	string entity;
+	boost::int64_t start;
+
+	bool operator== ( const WindowKey& wk ) const;
+};
+
+size_t hash_value ( const WindowKey& wk );
+
+typedef boost::unordered_map<string,int> FeaturesScore;
+
+class SentimentAggregator {
+public:
+	SentimentAggregator ( unsigned int window_size,
+						  unsigned int window_slide,
+						  unsigned int top_features );
+	bool Add ( const string& entity, boost::int64_t timestamp,
+			   const CDecision& cd, vector<WindowSummary>& closed );
+	void Flush ( vector<WindowSummary>& closed );
+
+	unsigned int getWindowSize () const;
+	unsigned int getWindowSlide () const;
+	unsigned int getActiveWindows () const;
+	unsigned int getDroppedLate () const;
+
+private:
+	struct WindowStats {
+		WindowSummary summary;
+		FeaturesScore features;
+	};
+
+	typedef boost::unordered_map<WindowKey,WindowStats> WindowsTable;
+	typedef map< boost::int64_t, vector<string> > WindowsQueue;
+
+	unsigned int WindowSize;
+	unsigned int WindowSlide;
+	unsigned int TopFeatures;
+
+	boost::int64_t watermark;
+	unsigned int dropped_late;
+
+	WindowsTable windows;
+	// open windows by entity and start
+
+	WindowsQueue closing;
+	// entities of open windows by window start, in arrival order
+
+	void closeWindows ( boost::int64_t until, vector<WindowSummary>& closed );
+	void closeOldest ( vector<WindowSummary>& closed );
+	void emitWindow ( WindowStats& ws, vector<WindowSummary>& closed );
+};
+
+#endif /* SENTIMENTAGGREGATOR_H_ */
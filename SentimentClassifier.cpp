@@ -6,50 +6,171 @@
  */
 
 #include "SentimentClassifier.h"
-
+#include "ColdFeatures.h"
+#include "FeatureIndex.h"
+#include "NumaPlacement.h"
+#include "NearDuplicateIndex.h"
+#include "TextUtils.h"
+#include "WorkerPool.h"
+
+#include <ctype.h>
 #include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/xpressive/xpressive.hpp>
 
 using namespace boost::xpressive;
 
-bool SentimentClassifier::classifySentences ( int weight,
-		const string& ucontent, CDecision& cd )
+struct SentimentClassifier::BudgetState
+// deadline and progress of one bounded Classify
 {
-	string content ( ucontent );
+	BudgetState ( unsigned int deadline_usec );
+	bool Expired ();
 
-	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
-	content = regex_replace ( content, urlx, " " );
+	bool timed;
+	boost::posix_time::ptime deadline;
+
+	unsigned int truncated;
+	// BudgetDeadline once the deadline has cut classification short
+
+	unsigned int fields;
+	// fields of title, body and url classified
+
+	size_t consumed;
+	// bytes of the last field (or of content) classified
+};
+
+// Bounded calls normalize and match input this many bytes at a time,
+// checking the deadline in between
+static const size_t BudgetPiece = 1024;
+
+SentimentClassifier::BudgetState::BudgetState ( unsigned int deadline_usec )
+	: timed ( deadline_usec > 0 ), deadline (), truncated (0), fields (0),
+	  consumed (0)
+{
+	if ( timed )
+		deadline = boost::posix_time::microsec_clock::universal_time() +
+				   boost::posix_time::microseconds ( deadline_usec );
+}
+
+bool SentimentClassifier::BudgetState::Expired ()
+// return true, flagging the decision as truncated, once the deadline passed
+{
+	if ( timed && boost::posix_time::microsec_clock::universal_time() >=
+			deadline )
+		truncated |= BudgetDeadline;
 
+	return truncated != 0;
+}
+
+bool SentimentClassifier::classifySentences ( int weight,
+		const string& ucontent, const FeatureOverlay& overlay, CDecision& cd,
+		BudgetState* budget )
+{
+	string content;
 	vector<string> sentences;
-	boost::split ( sentences, content, boost::is_any_of ( ";?!" ) );
 
-	for ( vector<string>::iterator sentence = sentences.begin();
-			sentence != sentences.end(); sentence++ ) {
-		CDecision cd_s;
-		string nsentence;
+	// bounded calls find urls and sentences a piece at a time instead
+	if ( ! budget ) {
+		sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+		content = regex_replace ( ucontent, urlx, " " );
 
-		if ( normalizeContent ( *sentence, nsentence ) )
-			classifyGreedy ( weight, nsentence, cd_s );
-		else return false;
+		boost::split ( sentences, content, boost::is_any_of ( ";?!" ) );
+	}
 
-		cd.content += cd_s.content + "; ";
-		cd.raw_score += cd_s.raw_score;
-		cd.confidence += cd_s.confidence;
-		cd.features.insert(cd.features.end(),
-						   cd_s.features.begin(),cd_s.features.end());
+	char status = 1;
+	unsigned int classified = sentences.size();
+
+	if ( ! budget && workers && DebugLevel < 2 && sentences.size() > 1 &&
+			content.size() >= ParallelThreshold ) {
+
+		// contiguous runs of sentences of about equal size per segment
+		unsigned int segments = workers->getThreads() + 1;
+		size_t target = content.size() / segments + 1;
+
+		vector<unsigned int> bounds ( 1, 0 );
+		size_t bytes = 0;
+		for ( unsigned int i = 0; i < sentences.size(); ++i ) {
+			bytes += sentences[i].size() + 1;
+			if ( bytes >= target && i + 1 < sentences.size() ) {
+				bounds.push_back ( i + 1 );
+				bytes = 0;
+			}
+		}
+		bounds.push_back ( sentences.size() );
+
+		unsigned int n = bounds.size() - 1;
+		vector<CDecision> parts ( n );
+		vector<char> statuses ( n, 1 );
+		vector<WorkerPool::Task> tasks;
+		for ( unsigned int k = 0; k < n; ++k )
+			tasks.push_back ( boost::bind (
+				&SentimentClassifier::classifySegment, this, weight,
+				&sentences, bounds[k], bounds[k+1], &overlay,
+				&parts[k], &statuses[k] ) );
+		workers->Run ( tasks );
+
+		// merged in sentence order, exactly as the sequential loop would
+		for ( unsigned int k = 0; k < n; ++k ) {
+			if ( ! statuses[k] ) return false;
+
+			cd.content += parts[k].content;
+			cd.raw_score += parts[k].raw_score;
+			cd.confidence += parts[k].confidence;
+			cd.features.insert(cd.features.end(),
+							   parts[k].features.begin(),parts[k].features.end());
+			cd.feature_scores.insert(cd.feature_scores.end(),
+					parts[k].feature_scores.begin(),parts[k].feature_scores.end());
+		}
+
+	} else if ( budget ) {
+
+		// a piece at a time, so the deadline can stop within a sentence
+		size_t begin = 0;
+		for ( classified = 0; ; ) {
+			CDecision cd_s;
+			size_t end;
+			bool isSuccess = classifyPieces ( weight, ucontent, begin,
+					true, false, overlay, cd_s, budget, end );
+			budget->consumed = end;
+			if ( ! isSuccess ) return false;
+
+			cd.content += cd_s.content + "; ";
+			cd.raw_score += cd_s.raw_score;
+			cd.confidence += cd_s.confidence;
+			cd.features.insert(cd.features.end(),
+							   cd_s.features.begin(),cd_s.features.end());
+			cd.feature_scores.insert(cd.feature_scores.end(),
+					cd_s.feature_scores.begin(),cd_s.feature_scores.end());
+			classified ++;
+
+			if ( end >= ucontent.size() || budget->Expired() )
+				break;
+			begin = end + 1;
+		}
+
+	} else {
+		classifySegment ( weight, &sentences, 0, sentences.size(),
+						  &overlay, &cd, &status );
+		if ( ! status ) return false;
 	}
 
 	if ( cd.features.size() == 0 ) {
 		cd.confidence = -1;
-		error_msg = "no decision could be reached";
+		setErrorMsg ( "no decision could be reached" );
 	} else {
-		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+		int min_sentiment = sentiment_threshold;
 
 		// confidence is average relevance normalized over observed features
-		cd.confidence /= int ( sentences.size() );
+		cd.confidence /= int ( classified );
 
 		// decision is based on sign of score
 		if ( cd.raw_score )
@@ -66,106 +187,1039 @@ bool SentimentClassifier::classifySentences ( int weight,
 	return ( cd.confidence >= 0 );
 }
 
+void SentimentClassifier::classifySegment ( int weight,
+		const vector<string>* sentences, unsigned int begin, unsigned int end,
+		const FeatureOverlay* overlay, CDecision* cd, char* status )
+// classify sentences [begin, end) and accumulate them into cd
+{
+	*status = 1;
+
+	for ( unsigned int i = begin; i < end; ++i ) {
+		CDecision cd_s;
+		string nsentence;
+
+		if ( normalizeContent ( (*sentences)[i], nsentence ) )
+			classifyGreedy ( weight, nsentence, *overlay, cd_s );
+		else {
+			*status = 0;
+			return;
+		}
+
+		cd->content += cd_s.content + "; ";
+		cd->raw_score += cd_s.raw_score;
+		cd->confidence += cd_s.confidence;
+		cd->features.insert(cd->features.end(),
+							cd_s.features.begin(),cd_s.features.end());
+		cd->feature_scores.insert(cd->feature_scores.end(),
+							cd_s.feature_scores.begin(),cd_s.feature_scores.end());
+	}
+}
+
+void SentimentClassifier::classifyField ( int weight, const string* content,
+		bool is_url, const FeatureOverlay* overlay, CDecision* cd, char* status )
+// normalize and classify one field of a title, body and url document
+{
+	string ncontent;
+
+	if ( is_url )
+		*status = normalizeUrl ( *content, ncontent );
+	else
+		*status = normalizeContent ( *content, ncontent );
+
+	if ( *status )
+		classifyGreedy ( weight, ncontent, *overlay, *cd );
+}
+
 bool SentimentClassifier::classifyGreedy ( int weight,
-		string& content, CDecision& cd )
+		string& content, const FeatureOverlay& overlay, CDecision& cd,
+		const FeaturesCount* matched )
+// score the features greedily matched in normalized content, unless the
+// caller matched them already
 {
 
 	try {
-		int cutoff = int ( FeatureScoreScale * RelevanceCutoff );
-		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+		int min_sentiment = sentiment_threshold;
 
 		cd.content = content;
 
-		vector<string> tokens;
-		boost::split ( tokens, content, boost::is_any_of ( " " ) );
-
-		if ( DebugLevel > 2 )
+		if ( DebugLevel > 2 && ! matched )
 			cout << "Content? " << cd.content << endl;
 
 		FeaturesCount fc;
+		if ( ! matched )
+			matchFeatures ( content, overlay, fc );
+		const FeaturesCount& counts = matched ? *matched : fc;
 
-		for ( unsigned int i=0; i < tokens.size(); ++i ) {
-			string test_feature = "";
-			unsigned int s = MaxFeatureSize;
+		int raw_score = 0;
+		for ( FeaturesCount::const_iterator it = counts.begin();
+				it != counts.end(); it++ ) {
+			FeatureScores fs;
+			lookupFeature ( overlay, it->first, fs );
 
-			for ( ; s > 0; --s ) {
+			int feature_score = featureScore ( it->second, fs.score );
+			raw_score += feature_score;
+			cd.confidence += fs.score;
+			//cd.confidence += relevance;
+
+			if ( DebugLevel > 0 ) {
 				stringstream ss;
-				unsigned int t = i+s;
-				if ( t <= tokens.size() ) {
-					ss << tokens[i];
-					for ( unsigned int u = i+1 ; u < t ; ++u )
-						ss << " " << tokens[u];
-					if ( DebugLevel > 2 )
-						cout << "Feature? " << ss.str();
-
-					if ( features.find ( ss.str() ) != features.end() ) {
-						if ( DebugLevel > 2 )
-							cout << "; YES rc = " <<
-								features[ ss.str() ].relevance;
-						if ( features[ ss.str() ].relevance > cutoff ) {
-							if ( DebugLevel > 2 )
-								cout << "; PASSES cutoff (" <<
-									cutoff << ")" << endl;
-							test_feature = ss.str();
-							break;
-						}
-					} else {
-						if ( DebugLevel > 2 )
-							cout << "; NO";
-					}
-					if ( DebugLevel > 2 )
-						cout << endl;
+				ss << it->first << " *";
+				ss << it->second << " = ";
+				ss << feature_score;
+				cd.features.push_back( ss.str() );
+			} else {
+				cd.features.push_back( it->first );
+			}
+			cd.feature_scores.push_back( weight * feature_score );
+		}
+
+		cd.raw_score += weight * raw_score;
+
+		if ( cd.features.size() == 0 ) {
+			cd.confidence = -1;
+			setErrorMsg ( "no decision could be reached" );
+		} else {
+			// confidence is average relevance normalized over observed features
+			cd.confidence /= int ( cd.features.size() );
+			cd.confidence = abs ( cd.confidence );
+
+			// decision is based on sign of score
+			if ( cd.raw_score )
+				cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+
+			// decision is neutral if score doesn't exceed threshold
+			if ( abs ( cd.raw_score ) < min_sentiment )
+				cd.decision = 0;
+
+			// decision is neutral if confidence is low
+			// if ( cd.confidence < min_sentiment ) cd.decision = 0;
+		}
+
+	} catch (...) {
+		cd.confidence = -1;
+		setErrorMsg ( "error in SentimentClassifier::classifyGreedy" );
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+bool SentimentClassifier::classifyPieces ( int weight, const string& content,
+		size_t begin, bool sentences, bool is_url,
+		const FeatureOverlay& overlay, CDecision& cd, BudgetState* budget,
+		size_t& end )
+// classify content from begin to the end of its sentence (when sentences)
+// or of content, BudgetPiece bytes at a time, and stop early once the
+// deadline has passed; end is set to where classification stopped. Pieces
+// are cut just before a space that follows a non-space, as in
+// normalizeContent, and matching runs only as far as the tokens read so
+// far decide it, so cd always equals classifying content [begin, end) in
+// one go. Urls are normalized whole. Return false on error
+{
+	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+	int cutoff = relevance_threshold;
+
+	string ncontent;
+	vector<string> tokens;
+	FeaturesCount fc;
+	unsigned int i = 0;
+
+	size_t piece = begin, j = begin, url_end = begin;
+	while ( true ) {
+		bool sentence_end = false;
+		for ( ; j < content.size(); ++j ) {
+			// as in classifySentences, separators inside urls do not count
+			if ( sentences && j >= url_end ) {
+				url_end = j + urlSpan ( content, j, false );
+				char c = content[j];
+				if ( j >= url_end && ( c == ';' || c == '?' || c == '!' ) ) {
+					sentence_end = true;
+					break;
 				}
 			}
+			if ( ! is_url && j >= piece + BudgetPiece && content[j] == ' ' &&
+					! isspace ( (unsigned char) content[j-1] ) )
+				break;
+		}
+
+		string text ( content, piece, j - piece ), ntext;
+		if ( sentences )
+			text = regex_replace ( text, urlx, " " );
+		if ( ! ( is_url ? normalizeUrl ( text, ntext ) :
+						  normalizeSegment ( text, ntext ) ) )
+			return false;
+
+		// joining non-empty normalized pieces with one space equals
+		// normalizing them together
+		if ( ! ntext.empty() ) {
+			vector<string> more;
+			boost::split ( more, ntext, boost::is_any_of ( " " ) );
+			tokens.insert ( tokens.end(), more.begin(), more.end() );
+			if ( ! ncontent.empty() )
+				ncontent += " ";
+			ncontent += ntext;
+		}
+
+		bool stop = sentence_end || j >= content.size() || budget->Expired();
+		if ( stop && tokens.empty() )
+			tokens.push_back ( "" );
 
-			if ( test_feature != "" ) {
-				if ( fc.find( test_feature ) == fc.end() )
-					fc[test_feature] = 0;
+		// a match at i is final once all MaxFeatureSize tokens from i are read
+		while ( i < tokens.size() && ( stop || i + MaxFeatureSize <= tokens.size() ) ) {
+			string test_feature;
+			unsigned int s = matchAt ( tokens, i, overlay, cutoff, test_feature );
+
+			if ( s > 0 ) {
 				fc[test_feature] ++;
 
-				if ( DebugLevel > 1 ) cout << test_feature <<
-						" (" << features[ test_feature ].score << ")"
-						<< endl;
+				if ( DebugLevel > 1 ) {
+					FeatureScores fs;
+					lookupFeature ( overlay, test_feature, fs );
+					cout << test_feature << " (" << fs.score << ")" << endl;
+				}
 
-				i += s-1;
+				i += s;
+			} else {
+				i ++;
 			}
 		}
 
-		for ( FeaturesCount::const_iterator it = fc.begin();
-				it != fc.end(); it++ ) {
+		if ( stop )
+			break;
+		piece = j;
+	}
 
-			FeatureScores* fs = &features[ it->first ];
+	end = j;
+	classifyGreedy ( weight, ncontent, overlay, cd, &fc );
 
-			float feature_weight =
-				( 1.f + log ( float ( it->second ) ) / log ( 2.f ) );
+	return true;
+}
 
-			int feature_score =
-				int ( feature_weight * float ( fs->score ) );
+void SentimentClassifier::matchFeatures ( const string& content,
+		const FeatureOverlay& overlay, FeaturesCount& fc ) const
+// greedily match the longest relevant feature at each token and count it
+{
+	int cutoff = relevance_threshold;
 
-			cd.raw_score += weight * feature_score;
+	vector<string> tokens;
+	boost::split ( tokens, content, boost::is_any_of ( " " ) );
 
-			cd.confidence += fs->score;
-			//cd.confidence += fs->relevance;
+	if ( ! workers || DebugLevel > 1 || content.size() < ParallelThreshold ) {
 
-			if ( DebugLevel > 0 ) {
-				stringstream ss;
-				ss << it->first << " *";
-				ss << it->second << " = ";
-				ss << feature_score;
-				cd.features.push_back( ss.str() );
+		for ( unsigned int i=0; i < tokens.size(); ++i ) {
+			string test_feature;
+			unsigned int s = matchAt ( tokens, i, overlay, cutoff, test_feature );
+
+			if ( s > 0 ) {
+				fc[test_feature] ++;
+
+				if ( DebugLevel > 1 ) {
+					FeatureScores fs;
+					lookupFeature ( overlay, test_feature, fs );
+					cout << test_feature << " (" << fs.score << ")" << endl;
+				}
+
+				i += s-1;
+			}
+		}
+
+		return;
+	}
+
+	// Each segment scans its own token range from its first token. Once
+	// the sequential scan lands on a position the segment also visited,
+	// the rest of the segment's matches are exactly the sequential ones;
+	// until then the scan continues token by token.
+	unsigned int n = workers->getThreads() + 1;
+	vector<MatchSegment> segs ( n );
+	vector<WorkerPool::Task> tasks;
+	for ( unsigned int k = 0; k < n; ++k ) {
+		segs[k].begin = tokens.size() * k / n;
+		segs[k].end = tokens.size() * ( k + 1 ) / n;
+		tasks.push_back ( boost::bind ( &SentimentClassifier::matchSegment,
+				this, &tokens, &overlay, &segs[k] ) );
+	}
+	workers->Run ( tasks );
+
+	unsigned int i = 0;
+	for ( unsigned int k = 0; k < n; ++k ) {
+		MatchSegment& seg = segs[k];
+
+		while ( i < seg.end &&
+				! binary_search ( seg.positions.begin(),
+								  seg.positions.end(), i ) ) {
+			string test_feature;
+			unsigned int s = matchAt ( tokens, i, overlay, cutoff, test_feature );
+			if ( s > 0 ) fc[test_feature] ++;
+			i += ( s > 0 ) ? s : 1;
+		}
+
+		if ( i < seg.end ) {
+			vector<unsigned int>::const_iterator m =
+				lower_bound ( seg.match_positions.begin(),
+							  seg.match_positions.end(), i );
+			for ( ; m != seg.match_positions.end(); m++ )
+				fc[ seg.match_features[ m - seg.match_positions.begin() ] ] ++;
+			i = seg.next;
+		}
+	}
+}
+
+void SentimentClassifier::matchSegment ( const vector<string>* tokens,
+		const FeatureOverlay* overlay, MatchSegment* seg ) const
+// greedily match features at positions [begin, end), recording every
+// position the scan visits
+{
+	int cutoff = relevance_threshold;
+
+	unsigned int i = seg->begin;
+	while ( i < seg->end ) {
+		string test_feature;
+		seg->positions.push_back ( i );
+
+		unsigned int s = matchAt ( *tokens, i, *overlay, cutoff, test_feature );
+		if ( s > 0 ) {
+			seg->match_positions.push_back ( i );
+			seg->match_features.push_back ( test_feature );
+			i += s;
+		} else {
+			i ++;
+		}
+	}
+	seg->next = i;
+}
+
+unsigned int SentimentClassifier::matchAt ( const vector<string>& tokens,
+		unsigned int i, const FeatureOverlay& overlay, int cutoff,
+		string& feature ) const
+// return token length of the longest relevant feature starting at token i,
+// or 0 if there is none
+{
+	for ( unsigned int s = MaxFeatureSize; s > 0; --s ) {
+		unsigned int t = i+s;
+		if ( t <= tokens.size() ) {
+			string phrase = makePhrase ( tokens, i, t );
+			if ( DebugLevel > 2 )
+				cout << "Feature? " << phrase;
+
+			FeatureScores fs;
+			if ( lookupFeature ( overlay, phrase, fs ) ) {
+				if ( DebugLevel > 2 )
+					cout << "; YES rc = " << fs.relevance;
+				if ( fs.relevance > cutoff ) {
+					if ( DebugLevel > 2 )
+						cout << "; PASSES cutoff (" <<
+							cutoff << ")" << endl;
+					feature = phrase;
+					return s;
+				}
 			} else {
-				cd.features.push_back( it->first );
+				if ( DebugLevel > 2 )
+					cout << "; NO";
 			}
+			if ( DebugLevel > 2 )
+				cout << endl;
+		}
+	}
+
+	return 0;
+}
+
+float SentimentClassifier::featureWeight ( int count )
+// weight of a feature observed count times in one piece of content
+{
+	return ( 1.f + log ( float ( count ) ) / log ( 2.f ) );
+}
+
+int SentimentClassifier::featureScore ( int count, int score ) const
+// score of a feature observed count times in one piece of content
+{
+	float feature_weight = ( count < FeatureWeights ) ?
+		feature_weights[ count ] : featureWeight ( count );
+
+	return int ( feature_weight * float ( score ) );
+}
+
+bool SentimentClassifier::lookupFeature ( const FeatureOverlay& overlay,
+		const string& phrase, FeatureScores& fs ) const
+// copy scores of phrase into fs, preferring online updates over the loaded
+// model; return false if phrase is not a feature
+{
+	if ( overlay.Find ( phrase, fs ) )
+		return true;
 
+	return baseFeature ( phrase, fs );
+}
+
+bool SentimentClassifier::baseFeature ( const string& phrase,
+		FeatureScores& fs ) const
+// copy loaded scores of phrase into fs from the hot table, then the cold
+// segment; return false if phrase is not in the loaded model
+{
+	if ( ! replicas.empty() ) {
+		if ( localReplica().Find ( phrase, fs ) )
+			return true;
+	} else {
+		FeaturesTable::const_iterator it = features.find ( phrase );
+		if ( it != features.end() ) {
+			fs = it->second;
+			return true;
 		}
+	}
+
+	return cold && cold->Find ( phrase, fs );
+}
+
+// NUMA node of each thread. A thread bound to a node keeps it; others
+// may migrate, so their node is looked up again every NodeRecheck lookups
+struct ThreadNode {
+	int node;
+	unsigned int lookups;
+	// lookups left before the node is looked up again
+};
+
+static const unsigned int NodeRecheck = 4096;
+static boost::thread_specific_ptr<ThreadNode> thread_node;
+
+const FeatureIndex& SentimentClassifier::localReplica () const
+{
+	if ( replicas.size() == 1 )
+		return *replicas[0];
+
+	ThreadNode* tn = thread_node.get();
+	if ( ! tn ) {
+		tn = new ThreadNode ();
+		tn->lookups = 0;
+		thread_node.reset ( tn );
+	}
+
+	if ( tn->lookups == 0 ) {
+		int bound = boundNode ();
+		tn->node = ( bound >= 0 ) ? bound : currentNode ();
+		tn->lookups = ( bound >= 0 ) ? ~0u : NodeRecheck;
+	}
+	-- tn->lookups;
+
+	return *replicas[ tn->node % replicas.size() ];
+}
+
+string SentimentClassifier::makePhrase ( const vector<string>& tokens,
+		unsigned int i, unsigned int t )
+// join tokens [i, t) into a single space-separated phrase
+{
+	string phrase ( tokens[i] );
+	for ( unsigned int u = i+1 ; u < t ; ++u ) {
+		phrase += " ";
+		phrase += tokens[u];
+	}
+	return phrase;
+}
+
+void SentimentClassifier::enumerateFeatures ( const string& ncontent,
+		FeaturesSet& phrases ) const
+// collect every n-gram of normalized content up to MaxFeatureSize tokens
+{
+	if ( ncontent.empty() )
+		return;
+
+	vector<string> tokens;
+	boost::split ( tokens, ncontent, boost::is_any_of ( " " ) );
+
+	for ( unsigned int i=0; i < tokens.size(); ++i )
+		for ( unsigned int t = i+1;
+				t <= tokens.size() && t <= i+MaxFeatureSize; ++t )
+			phrases.insert ( makePhrase ( tokens, i, t ) );
+}
+
+FeatureScores SentimentClassifier::feedbackScores ( const string& phrase,
+		const FeedbackCounts& counts ) const
+// loaded score shifted by the log-odds of labeled feedback; neutral labels
+// shrink the composite score towards zero
+{
+	FeatureScores fs;
+
+	FeatureScores loaded;
+	bool known = baseFeature ( phrase, loaded );
+	float base = known ? float ( loaded.score ) : 0.f;
+
+	float evidence = FeatureScoreScale *
+		log ( float ( counts.positive + 1 ) / float ( counts.negative + 1 ) );
+
+	float polar = float ( counts.positive + counts.negative + 1 );
+
+	fs.score = int ( ( base + evidence ) * polar /
+					 ( polar + float ( counts.neutral ) ) );
+	fs.relevance = abs ( fs.score );
+	fs.id = known ? loaded.id : counts.id;
+
+	return fs;
+}
+
+void SentimentClassifier::pruneFeedback ( FeedbackShard& shard ) const
+// drop counts of phrases that are neither loaded nor admitted and lack
+// support; the shard is pruned again only once it doubles, so phrases
+// that survive do not make every update rescan it
+{
+	for ( FeedbackTable::iterator it = shard.counts.begin();
+			it != shard.counts.end(); ) {
+		const FeedbackCounts& counts = it->second;
+		unsigned int support =
+			counts.positive + counts.neutral + counts.negative;
+		FeatureScores loaded;
+		if ( counts.id < 0 && support < FeedbackMinSupport &&
+				! baseFeature ( it->first, loaded ) )
+			shard.counts.erase ( it++ );
+		else
+			++it;
+	}
+
+	shard.prune_at = 2 * shard.counts.size();
+}
+
+bool SentimentClassifier::updateFeatures ( const FeaturesSet& phrases,
+		int label )
+{
+	bool isSuccess = false;
+
+	try {
+		vector<const string*> sharded[ FeedbackShards ];
+		boost::hash<string> hasher;
+
+		for ( FeaturesSet::const_iterator it = phrases.begin();
+				it != phrases.end(); it++ )
+			sharded[ hasher ( *it ) % FeedbackShards ].push_back ( &*it );
+
+		for ( unsigned int i = 0; i < FeedbackShards; ++i ) {
+			if ( sharded[i].empty() )
+				continue;
+
+			FeedbackShard& shard = feedback[i];
+			boost::mutex::scoped_lock lock ( shard.lock );
+
+			FeaturesTable scores;
+			for ( vector<const string*>::const_iterator it = sharded[i].begin();
+					it != sharded[i].end(); it++ ) {
+				const string& phrase = **it;
+
+				FeedbackCounts& counts = shard.counts[ phrase ];
+				if ( label > 0 ) counts.positive ++;
+				else if ( label < 0 ) counts.negative ++;
+				else counts.neutral ++;
+
+				// unseen phrases enter the model only with enough support
+				unsigned int support =
+					counts.positive + counts.neutral + counts.negative;
+				FeatureScores loaded;
+				bool known = baseFeature ( phrase, loaded );
+				if ( known || support >= FeedbackMinSupport ) {
+					if ( ! known && counts.id < 0 ) {
+						boost::mutex::scoped_lock id_lock ( pending_lock );
+						counts.id = next_feature_id ++;
+					}
+					scores[ phrase ] = feedbackScores ( phrase, counts );
+				}
+			}
+
+			if ( shard.counts.size() > max ( shard.prune_at,
+					size_t ( FeedbackCapacity / FeedbackShards ) ) )
+				pruneFeedback ( shard );
+
+			// scores are queued before the shard is released, so pending
+			// holds them in the order their counts changed
+			boost::mutex::scoped_lock pending_held ( pending_lock );
+			for ( FeaturesTable::const_iterator it = scores.begin();
+					it != scores.end(); it++ )
+				pending[ it->first ] = it->second;
+		}
+
+		bool publish = false, snapshot = false;
+		{
+			boost::mutex::scoped_lock lock ( pending_lock );
+
+			// epochs end after UpdateEpochSize documents or, when updates
+			// trickle in, UpdateEpochInterval milliseconds
+			publish = ( ++pending_docs >= UpdateEpochSize ) ||
+				( UpdateEpochInterval > 0 &&
+				  boost::posix_time::microsec_clock::universal_time() - published >=
+				  boost::posix_time::milliseconds ( UpdateEpochInterval ) );
+			snapshot = ( FeedbackSnapshotInterval > 0 &&
+					++snapshot_docs >= FeedbackSnapshotInterval );
+			if ( snapshot ) snapshot_docs = 0;
+		}
+
+		isSuccess = true;
+		if ( publish )
+			isSuccess = publishUpdates ();
+		if ( snapshot && isSuccess )
+			isSuccess = saveFeedback ( FeedbackSnapshotFile );
+
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::updateFeatures" );
+	}
+
+	return isSuccess;
+}
+
+bool SentimentClassifier::classifyQuestionMarks ( int weight,
+		const string& ucontent, CDecision& cd)
+{
+	string feature ( ucontent );
+
+	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+	feature = regex_replace ( feature, urlx, " " );
+
+	float qm_ratio = float ( feature.size() );
+
+	sregex non_qmx = sregex::compile( "[^\\?]" );
+	feature = regex_replace ( feature, non_qmx, "" );
+
+	qm_ratio = float ( feature.size() ) / qm_ratio;
+	float raw_score = 0.f;
+	if ( qm_ratio > 0.001f )
+		raw_score = FeatureScoreScale * ( -156.f * qm_ratio - 0.3f );
+
+	//float qm_count = float ( feature.size() );
+	//float raw_score = FeatureScoreScale * -0.37f * sqrt ( qm_count );
+
+	cd.confidence = 0;
+	cd.decision = cd.raw_score < 0 ? -1 : 0;
+	cd.raw_score = weight * int ( raw_score );
+	if ( DebugLevel > 0 ) {
+		stringstream ss;
+		ss << "?: '" << feature << "' = " << int ( raw_score );
+		cd.features.push_back( ss.str() );
+		cd.feature_scores.push_back( cd.raw_score );
+	} else if ( qm_ratio > 0.f ) {
+		cd.features.push_back( feature );
+		cd.feature_scores.push_back( cd.raw_score );
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+CDecision::CDecision ()
+	: decision(0), raw_score(0), confidence(0), content(), features(),
+	  feature_scores(), inherited(false), truncated(0), bytes_processed(0),
+	  tokens_processed(0), sentences_processed(0)
+{}
+
+ClassifyBudget::ClassifyBudget ()
+	: max_bytes(0), max_tokens(0), max_sentences(0), deadline_usec(0)
+{}
+
+FeatureScores::FeatureScores ()
+	: score(0), relevance(0), id(-1)
+{}
+
+FeedbackCounts::FeedbackCounts ()
+	: positive(0), neutral(0), negative(0), id(-1)
+{}
+
+FeatureOverlay::FeatureOverlay ()
+	: scores(), base()
+{}
+
+bool FeatureOverlay::Find ( const string& phrase, FeatureScores& fs ) const
+// copy scores of phrase from the newest layer holding it into fs
+{
+	for ( const FeatureOverlay* layer = this; layer; layer = layer->base.get() ) {
+		FeaturesTable::const_iterator it = layer->scores.find ( phrase );
+		if ( it != layer->scores.end() ) {
+			fs = it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+void FeatureOverlay::Flatten ( FeaturesTable& table ) const
+// add the newest scores of every phrase in the overlay to table
+{
+	for ( const FeatureOverlay* layer = this; layer; layer = layer->base.get() )
+		table.insert ( layer->scores.begin(), layer->scores.end() );
+}
+
+SentimentClassifier::FeedbackShard::FeedbackShard ()
+	: lock(), counts(), prune_at(0)
+{}
+
+SentimentClassifier::SentimentClassifier (
+		const string& feature_file, const string& stopword_file)
+	: UseQuestionMarks (true),
+	  RelevanceCutoff (1.0f), NeutralCutoff (1.0f), MaxFeatureSize (3),
+	  DebugLevel (0), FeedbackMinSupport (3), UpdateEpochSize (1000),
+	  UpdateEpochInterval (1000),
+	  FeedbackCapacity (262144),
+	  FeedbackSnapshotInterval (0), FeedbackSnapshotFile (),
+	  ParallelThreshold (65536),
+	  ReferenceEngine (false),
+	  error_msg (),
+	  error_lock (),
+	  TitleWeight (3), BodyWeight (1),
+	  URLWeight (1), isInited (false), features (), stopwords (),
+	  cold (),
+	  replicas (),
+	  workers (),
+	  duplicates (),
+	  updates ( new FeatureOverlay () ),
+	  pending (),
+	  pending_docs (0),
+	  published ( boost::posix_time::microsec_clock::universal_time() ),
+	  snapshot_docs (0), epoch (0), next_feature_id (0), model_ids (0)
+{
+	for ( int c = 0; c < FeatureWeights; ++c )
+		feature_weights[c] = featureWeight ( c );
+	resolveThresholds ();
+
+	isInited =
+			readFeatures (feature_file);
+//			&& readStopwords (stopword_file);
+}
+
+bool SentimentClassifier::Classify (
+		const string& content, CDecision& cd)
+// return true if sentiment classification is successful; return false otherwise;
+{
+	if ( ReferenceEngine )
+		return referenceClassify ( content, cd );
+
+	if ( ! duplicates )
+		return classifyContent ( content, cd, NULL );
+
+	// generations of single content decisions are even
+	SimHash sh;
+	sh.Add ( content, 0 );
+	boost::uint64_t fp = sh.Value();
+	unsigned int generation = getUpdateEpoch() * 2;
+
+	if ( duplicates->Find ( fp, generation, cd ) )
+		return true;
+
+	bool isSuccess = classifyContent ( content, cd, NULL );
+	if ( isSuccess )
+		duplicates->Insert ( fp, generation, cd );
+
+	return isSuccess;
+}
+
+bool SentimentClassifier::Classify (
+		const string& title, const string& body,
+		const string& url, CDecision& cd)
+// return true if sentiment classification is successful; return false otherwise;
+{
+	if ( ReferenceEngine )
+		return referenceClassify ( title, body, url, cd );
+
+	if ( ! duplicates )
+		return classifyTitleBodyUrl ( title, body, url, cd, NULL );
+
+	// generations of title, body and url decisions are odd
+	SimHash sh;
+	sh.Add ( title, 1 );
+	sh.Add ( body, 2 );
+	sh.Add ( url, 3 );
+	boost::uint64_t fp = sh.Value();
+	unsigned int generation = getUpdateEpoch() * 2 + 1;
+
+	if ( duplicates->Find ( fp, generation, cd ) )
+		return true;
+
+	bool isSuccess = classifyTitleBodyUrl ( title, body, url, cd, NULL );
+	if ( isSuccess )
+		duplicates->Insert ( fp, generation, cd );
+
+	return isSuccess;
+}
+
+static size_t budgetPrefix ( const string& content,
+		const ClassifyBudget& budget, CDecision& cd )
+// return length of the longest prefix of content within what is left of
+// budget after the input already counted in cd; add the prefix to the
+// counts in cd and flag the limit that cut it
+{
+	size_t bytes = cd.bytes_processed;
+	unsigned int tokens = cd.tokens_processed, sentences = 1;
+	unsigned int token_sentences = sentences;
+	size_t i = 0, token_start = 0, url_end = 0;
+	bool in_token = false;
+	unsigned int cut = 0;
+
+	for ( ; i < content.size(); ++i ) {
+		char c = content[i];
+		bool space = isspace ( (unsigned char) c );
+		unsigned int previous_sentences = sentences;
+
+		if ( budget.max_bytes && bytes >= budget.max_bytes ) {
+			cut = BudgetBytes;
+			break;
+		}
+
+		// classifySentences removes http: urls before splitting, so
+		// separators inside them do not end sentences
+		if ( i >= url_end )
+			url_end = i + urlSpan ( content, i, false );
+
+		if ( i >= url_end && ( c == ';' || c == '?' || c == '!' ) ) {
+			if ( budget.max_sentences && sentences >= budget.max_sentences ) {
+				cut = BudgetSentences;
+				break;
+			}
+			sentences ++;
+		}
+		if ( ! space && ! in_token ) {
+			if ( budget.max_tokens && tokens >= budget.max_tokens ) {
+				cut = BudgetTokens;
+				break;
+			}
+			tokens ++;
+			token_start = i;
+			token_sentences = previous_sentences;
+		}
+
+		in_token = ! space;
+		bytes ++;
+	}
+
+	// a word cut by the byte budget is dropped whole, unless it is the
+	// first word of the input
+	if ( cut == BudgetBytes && in_token &&
+			( token_start > 0 || cd.bytes_processed > 0 ) &&
+			! isspace ( (unsigned char) content[i] ) ) {
+		bytes -= i - token_start;
+		tokens --;
+		sentences = token_sentences;
+		i = token_start;
+	}
+
+	cd.bytes_processed = bytes;
+	cd.tokens_processed = tokens;
+	cd.sentences_processed += sentences;
+	cd.truncated |= cut;
+
+	return i;
+}
+
+static bool budgetLimited ( const ClassifyBudget& budget )
+// return true if budget limits bytes, tokens or sentences
+{
+	return budget.max_bytes || budget.max_tokens || budget.max_sentences;
+}
+
+bool SentimentClassifier::Classify ( const string& content,
+		const ClassifyBudget& budget, CDecision& cd )
+// classify the prefix of content that fits budget; cd is flagged as
+// truncated if it does not cover all of content and counts the input
+// actually classified. Bounded calls always run sequentially and bypass
+// near-duplicate reuse, whose SimHash would read all of content
+{
+	BudgetState state ( budget.deadline_usec );
+
+	string cut;
+	if ( budgetLimited ( budget ) ) {
+		CDecision limited;
+		cut.assign ( content, 0, budgetPrefix ( content, budget, limited ) );
+		cd.truncated |= limited.truncated;
+	}
+	const string& prefix = budgetLimited ( budget ) ? cut : content;
+
+	bool isSuccess;
+	if ( ReferenceEngine ) {
+		isSuccess = referenceClassify ( prefix, cd );
+		state.consumed = prefix.size();
+	} else {
+		isSuccess = classifyContent ( prefix, cd, &state );
+	}
+
+	// input is counted once classified, so the deadline bounds counting too
+	CDecision counted;
+	if ( state.consumed < prefix.size() )
+		budgetPrefix ( prefix.substr ( 0, state.consumed ), ClassifyBudget (),
+					   counted );
+	else
+		budgetPrefix ( prefix, ClassifyBudget (), counted );
+
+	cd.bytes_processed = counted.bytes_processed;
+	cd.tokens_processed = counted.tokens_processed;
+	cd.sentences_processed = counted.sentences_processed;
+	cd.truncated |= state.truncated;
+
+	return isSuccess;
+}
+
+bool SentimentClassifier::Classify (
+		const string& title, const string& body,
+		const string& url, const ClassifyBudget& budget, CDecision& cd )
+// classify the prefixes of title, body and url that fit budget, which is
+// spent on the fields in that order; sentences are not limited
+{
+	BudgetState state ( budget.deadline_usec );
+
+	ClassifyBudget field_budget ( budget );
+	field_budget.max_sentences = 0;
+
+	string cut[3];
+	if ( budgetLimited ( field_budget ) ) {
+		CDecision limited;
+		cut[0].assign ( title, 0, budgetPrefix ( title, field_budget, limited ) );
+		cut[1].assign ( body, 0, budgetPrefix ( body, field_budget, limited ) );
+		cut[2].assign ( url, 0, budgetPrefix ( url, field_budget, limited ) );
+		cd.truncated |= limited.truncated;
+	}
+	const string* fields[3] = { &title, &body, &url };
+	if ( budgetLimited ( field_budget ) )
+		for ( unsigned int f = 0; f < 3; ++f )
+			fields[f] = &cut[f];
+
+	bool isSuccess;
+	if ( ReferenceEngine ) {
+		isSuccess = referenceClassify ( *fields[0], *fields[1], *fields[2], cd );
+		state.fields = 3;
+		state.consumed = fields[2]->size();
+	} else {
+		isSuccess = classifyTitleBodyUrl ( *fields[0], *fields[1], *fields[2],
+										   cd, &state );
+	}
+
+	// only the fields (and the part of the last one) classified are counted
+	CDecision counted;
+	for ( unsigned int f = 0; f < state.fields; ++f ) {
+		if ( f + 1 == state.fields && state.consumed < fields[f]->size() )
+			budgetPrefix ( fields[f]->substr ( 0, state.consumed ),
+						   ClassifyBudget (), counted );
+		else
+			budgetPrefix ( *fields[f], ClassifyBudget (), counted );
+	}
+
+	cd.bytes_processed = counted.bytes_processed;
+	cd.tokens_processed = counted.tokens_processed;
+	cd.sentences_processed = 0;
+	cd.truncated |= state.truncated;
+
+	return isSuccess;
+}
+
+bool SentimentClassifier::classifyContent (
+		const string& content, CDecision& cd, BudgetState* budget )
+{
+	FeatureOverlayPtr overlay = boost::atomic_load ( &updates );
+
+	if ( ! classifySentences ( 1, content, *overlay, cd, budget ) )
+		return false;
+
+	if ( UseQuestionMarks && ! ( budget && budget->Expired() ) ) {
+		CDecision cd_qm;
+		classifyQuestionMarks ( 1, content, cd_qm );
+
+		if ( cd_qm.features.size() > 0 ) {
+			cd.features.push_back( cd_qm.features[0] );
+			cd.feature_scores.push_back( cd_qm.feature_scores[0] );
+		}
+		cd.raw_score += cd_qm.raw_score;
+
+		int min_sentiment = sentiment_threshold;
+
+		// decision is based on sign of score
+		if ( cd.raw_score )
+			cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+
+		// decision is neutral if score doesn't exceed threshold
+		if ( abs ( cd.raw_score ) < min_sentiment )
+			cd.decision = 0;
+	}
+
+	return true;
+}
+
+bool SentimentClassifier::classifyTitleBodyUrl (
+		const string& title, const string& body,
+		const string& url, CDecision& cd, BudgetState* budget )
+{
+	FeatureOverlayPtr overlay = boost::atomic_load ( &updates );
+
+	CDecision cd_title, cd_body, cd_url;
+	char status[3] = { 1, 1, 1 };
+
+	if ( ! budget && workers && DebugLevel < 2 &&
+			title.size() + body.size() + url.size() >= ParallelThreshold ) {
+		vector<WorkerPool::Task> tasks;
+		tasks.push_back ( boost::bind ( &SentimentClassifier::classifyField,
+				this, TitleWeight, &title, false, overlay.get(),
+				&cd_title, &status[0] ) );
+		tasks.push_back ( boost::bind ( &SentimentClassifier::classifyField,
+				this, BodyWeight, &body, false, overlay.get(),
+				&cd_body, &status[1] ) );
+		tasks.push_back ( boost::bind ( &SentimentClassifier::classifyField,
+				this, URLWeight, &url, true, overlay.get(),
+				&cd_url, &status[2] ) );
+		workers->Run ( tasks );
+	} else if ( budget ) {
+		// a piece at a time; fields the deadline stops short of are
+		// classified as empty
+		budget->fields = 1;
+		status[0] = classifyPieces ( TitleWeight, title, 0, false, false,
+				*overlay, cd_title, budget, budget->consumed );
+		if ( status[0] && ! budget->Expired() ) {
+			budget->fields = 2;
+			status[1] = classifyPieces ( BodyWeight, body, 0, false, false,
+				*overlay, cd_body, budget, budget->consumed );
+		}
+		if ( status[0] && status[1] && budget->fields == 2 &&
+				! budget->Expired() ) {
+			budget->fields = 3;
+			status[2] = classifyPieces ( URLWeight, url, 0, false, true,
+				*overlay, cd_url, budget, budget->consumed );
+		}
+	} else {
+		classifyField ( TitleWeight, &title, false, overlay.get(),
+						&cd_title, &status[0] );
+		if ( status[0] )
+			classifyField ( BodyWeight, &body, false, overlay.get(),
+							&cd_body, &status[1] );
+		if ( status[0] && status[1] )
+			classifyField ( URLWeight, &url, true, overlay.get(),
+							&cd_url, &status[2] );
+	}
+
+	if ( ! ( status[0] && status[1] && status[2] ) )
+		return false;
+
+	try {
+		int min_sentiment = sentiment_threshold;
+
+		cd.content  =
+				cd_title.content + "+ " +
+				cd_body.content + "+ " +
+				cd_url.content;
+
+		cd.features.insert(cd.features.end(),
+						   cd_title.features.begin(),cd_title.features.end());
+		cd.features.insert(cd.features.end(),
+						   cd_body.features.begin(),cd_body.features.end());
+		cd.features.insert(cd.features.end(),
+						   cd_url.features.begin(),cd_url.features.end());
+
+		cd.feature_scores.insert(cd.feature_scores.end(),
+				cd_title.feature_scores.begin(),cd_title.feature_scores.end());
+		cd.feature_scores.insert(cd.feature_scores.end(),
+				cd_body.feature_scores.begin(),cd_body.feature_scores.end());
+		cd.feature_scores.insert(cd.feature_scores.end(),
+				cd_url.feature_scores.begin(),cd_url.feature_scores.end());
+
+		cd.raw_score =
+				cd_title.raw_score +
+				cd_body.raw_score +
+				cd_url.raw_score;
+
 
 		if ( cd.features.size() == 0 ) {
 			cd.confidence = -1;
-			error_msg = "no decision could be reached";
+			setErrorMsg ( "no decision could be reached" );
 		} else {
 			// confidence is average relevance normalized over observed features
-			cd.confidence /= int ( cd.features.size() );
-			cd.confidence = abs ( cd.confidence );
+			cd.confidence =
+				(	cd_title.confidence * TitleWeight +
+					cd_body.confidence * BodyWeight +
+					cd_url.confidence * URLWeight 	) /
+				(	TitleWeight + BodyWeight + URLWeight 	);
 
 			// decision is based on sign of score
 			if ( cd.raw_score )
@@ -180,168 +1234,547 @@ bool SentimentClassifier::classifyGreedy ( int weight,
 		}
 
 	} catch (...) {
-		cd.confidence = -1;
-		error_msg = "error in SentimentClassifier::classifyGreedy";
+		cd.confidence = -1;
+		setErrorMsg ( "error in SentimentClassifier::Classify" );
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+static bool sparseFeatureLess ( const SparseFeature& a,
+		const SparseFeature& b )
+// order exported features by field, then feature id
+{
+	return ( a.field != b.field ) ? a.field < b.field : a.id < b.id;
+}
+
+static void mergeSparseFeatures ( SparseVector& sv )
+// sort exported features and sum repeats of a feature within a field
+{
+	sort ( sv.begin(), sv.end(), sparseFeatureLess );
+
+	unsigned int n = 0;
+	for ( unsigned int i = 0; i < sv.size(); ++i ) {
+		if ( n > 0 && sv[n-1].field == sv[i].field && sv[n-1].id == sv[i].id ) {
+			sv[n-1].count += sv[i].count;
+			sv[n-1].score += sv[i].score;
+		} else {
+			sv[n++] = sv[i];
+		}
+	}
+	sv.resize ( n );
+}
+
+void SentimentClassifier::extractFeatures ( int weight, unsigned int field,
+		const string& ncontent, const FeatureOverlay& overlay,
+		SparseVector& sv ) const
+// append matched features of normalized content without scoring a decision
+{
+	FeaturesCount fc;
+	matchFeatures ( ncontent, overlay, fc );
+
+	for ( FeaturesCount::const_iterator it = fc.begin();
+			it != fc.end(); it++ ) {
+		FeatureScores fs;
+		lookupFeature ( overlay, it->first, fs );
+
+		SparseFeature f;
+		f.id = fs.id;
+		f.field = field;
+		f.count = it->second;
+		f.score = weight * featureScore ( it->second, fs.score );
+		sv.push_back ( f );
+	}
+}
+
+bool SentimentClassifier::Extract ( const string& content, SparseVector& sv )
+// export matched features of content as a sparse vector; return false on error
+{
+	bool isSuccess = false;
+
+	try {
+		FeatureOverlayPtr overlay = boost::atomic_load ( &updates );
+
+		string ucontent ( content );
+
+		sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+		ucontent = regex_replace ( ucontent, urlx, " " );
+
+		vector<string> sentences;
+		boost::split ( sentences, ucontent, boost::is_any_of ( ";?!" ) );
+
+		sv.clear();
+		for ( vector<string>::iterator sentence = sentences.begin();
+				sentence != sentences.end(); sentence++ ) {
+			string nsentence;
+			if ( normalizeContent ( *sentence, nsentence ) )
+				extractFeatures ( 1, ContentField, nsentence, *overlay, sv );
+			else return false;
+		}
+		mergeSparseFeatures ( sv );
+
+		isSuccess = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::Extract" );
+	}
+
+	return isSuccess;
+}
+
+bool SentimentClassifier::Extract (
+		const string& title, const string& body,
+		const string& url, SparseVector& sv )
+// export matched features of title, body and url; return false on error
+{
+	bool isSuccess = false;
+
+	try {
+		FeatureOverlayPtr overlay = boost::atomic_load ( &updates );
+
+		string ncontent;
+		sv.clear();
+
+		if ( normalizeContent ( title, ncontent ) )
+			extractFeatures ( TitleWeight, TitleField, ncontent, *overlay, sv );
+		else return false;
+
+		if ( normalizeContent ( body, ncontent ) )
+			extractFeatures ( BodyWeight, BodyField, ncontent, *overlay, sv );
+		else return false;
+
+		if ( normalizeUrl ( url, ncontent ) )
+			extractFeatures ( URLWeight, UrlField, ncontent, *overlay, sv );
+		else return false;
+
+		mergeSparseFeatures ( sv );
+
+		isSuccess = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::Extract" );
+	}
+
+	return isSuccess;
+}
+
+bool SentimentClassifier::saveFeatureIds ( const string& ids_file ) const
+// write feature identifiers and phrases (tab-separated) for exported vectors
+{
+	ofstream fs ( ids_file.c_str() );
+	if ( ! fs.good() )
+		return false;
+
+	for ( FeaturesTable::const_iterator it = features.begin();
+			it != features.end(); it++ )
+		fs << it->second.id << '\t' << it->first << '\n';
+
+	// cold blocks are read one at a time, bypassing the block cache
+	for ( unsigned int b = 0; cold && b < cold->getBlocks(); ++b ) {
+		FeaturesTable block;
+		if ( ! cold->readBlock ( b, block ) )
+			return false;
+		for ( FeaturesTable::const_iterator it = block.begin();
+				it != block.end(); it++ )
+			fs << it->second.id << '\t' << it->first << '\n';
+	}
+
+	FeaturesTable overlay;
+	boost::atomic_load ( &updates )->Flatten ( overlay );
+	for ( FeaturesTable::const_iterator it = overlay.begin();
+			it != overlay.end(); it++ ) {
+		FeatureScores loaded;
+		if ( ! baseFeature ( it->first, loaded ) )
+			fs << it->second.id << '\t' << it->first << '\n';
+	}
+
+	fs.close();
+	return ! fs.fail();
+}
+
+struct TierRank
+// data structure for ranking features when splitting hot and cold tiers
+{
+	const string* phrase;
+	const FeatureScores* scores;
+	long frequency;
+	unsigned int tokens;
+};
+
+static bool tierRankLess ( const TierRank& a, const TierRank& b )
+// frequent, then short, then relevant features first
+{
+	if ( a.frequency != b.frequency ) return a.frequency > b.frequency;
+	if ( a.tokens != b.tokens ) return a.tokens < b.tokens;
+	if ( a.scores->relevance != b.scores->relevance )
+		return a.scores->relevance > b.scores->relevance;
+	return *a.phrase < *b.phrase;
+}
+
+bool SentimentClassifier::saveTiers ( const string& hot_file,
+		const string& cold_file, size_t hot_bytes,
+		const string& ranking_file )
+// split the loaded model into a hot features file of about hot_bytes in
+// memory and a cold segment file; features are ranked by frequency in
+// ranking_file (phrase, then count) when given; return false on error
+{
+	bool isSuccess = false;
+
+	try {
+		FeaturesTable all ( features );
+		for ( unsigned int b = 0; cold && b < cold->getBlocks(); ++b )
+			if ( ! cold->readBlock ( b, all ) ) {
+				setErrorMsg ( cold->getErrorMsg() );
+				return false;
+			}
+
+		map<string,long> frequency;
+		if ( ! ranking_file.empty() ) {
+			ifstream rs ( ranking_file.c_str() );
+			if ( ! rs.good() ) {
+				setErrorMsg ( "Failed to open ranking file." );
+				return false;
+			}
+			string phrase, entry;
+			while ( getline ( rs, phrase, '\t' ) ) {
+				getline ( rs, entry, '\n' );
+				stringstream iss ( entry );
+				iss >> frequency[ phrase ];
+			}
+		}
+
+		vector<TierRank> ranks;
+		ranks.reserve ( all.size() );
+		for ( FeaturesTable::const_iterator it = all.begin();
+				it != all.end(); it++ ) {
+			TierRank r;
+			r.phrase = &it->first;
+			r.scores = &it->second;
+			map<string,long>::const_iterator f = frequency.find ( it->first );
+			r.frequency = ( f != frequency.end() ) ? f->second : 0;
+			r.tokens = count ( it->first.begin(), it->first.end(), ' ' ) + 1;
+			ranks.push_back ( r );
+		}
+		sort ( ranks.begin(), ranks.end(), tierRankLess );
+
+		// bytes of a hot entry: phrase, scores and map node overhead
+		static const size_t EntryOverhead =
+			sizeof ( FeaturesTable::value_type ) + 4 * sizeof ( void* );
+
+		ofstream hs ( hot_file.c_str() );
+		if ( ! hs.good() ) {
+			setErrorMsg ( "Failed to open hot features file." );
+			return false;
+		}
+
+		FeaturesTable cold_features;
+		size_t bytes = 0;
+		for ( vector<TierRank>::const_iterator it = ranks.begin();
+				it != ranks.end(); it++ ) {
+			bytes += EntryOverhead + it->phrase->size();
+			if ( bytes <= hot_bytes )
+				hs << *it->phrase << '\t' << it->scores->score << '\t'
+				   << it->scores->id << '\n';
+			else
+				cold_features[ *it->phrase ] = *it->scores;
+		}
+		hs.close();
+
+		if ( hs.fail() || ! ColdFeatures::Write ( cold_file, cold_features,
+												  next_feature_id ) ) {
+			setErrorMsg ( "Failed to write tiered features." );
+			return false;
+		}
+
+		isSuccess = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::saveTiers" );
 	}
 
-	return ( cd.confidence >= 0 );
+	return isSuccess;
 }
 
-bool SentimentClassifier::classifyQuestionMarks ( int weight,
-		const string& ucontent, CDecision& cd)
+bool SentimentClassifier::setModelPlacement ( bool huge_pages,
+		bool node_replicas )
+// serve features from flat copies in huge pages (when huge_pages) and one
+// per NUMA node (when node_replicas); placement falls back to ordinary
+// pages and nodes silently, see getModelRegion. Return false on error
 {
-	string feature ( ucontent );
+	bool isSuccess = false;
 
-	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
-	feature = regex_replace ( feature, urlx, " " );
+	try {
+		unsigned int nodes = node_replicas ? numaNodes () : 1;
+		vector< boost::shared_ptr<const FeatureIndex> > placed;
+
+		for ( unsigned int node = 0; node < nodes; ++node ) {
+			boost::shared_ptr<FeatureIndex> index ( new FeatureIndex () );
+			if ( ! index->Build ( features, huge_pages,
+								  node_replicas ? int ( node ) : -1 ) ) {
+				setErrorMsg ( "Failed to allocate feature index." );
+				return false;
+			}
+			placed.push_back ( index );
+		}
 
-	float qm_ratio = float ( feature.size() );
+		replicas.swap ( placed );
+		isSuccess = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::setModelPlacement" );
+	}
 
-	sregex non_qmx = sregex::compile( "[^\\?]" );
-	feature = regex_replace ( feature, non_qmx, "" );
+	return isSuccess;
+}
 
-	qm_ratio = float ( feature.size() ) / qm_ratio;
-	float raw_score = 0.f;
-	if ( qm_ratio > 0.001f )
-		raw_score = FeatureScoreScale * ( -156.f * qm_ratio - 0.3f );
+bool SentimentClassifier::openColdFeatures ( const string& cold_file,
+		size_t cache_bytes )
+// serve features missing from the loaded table from a cold segment file,
+// caching up to cache_bytes of decoded blocks; the loaded (hot) table is
+// served from a flat index unless it is placed already. Return false on error
+{
+	bool isSuccess = false;
 
-	//float qm_count = float ( feature.size() );
-	//float raw_score = FeatureScoreScale * -0.37f * sqrt ( qm_count );
+	try {
+		boost::shared_ptr<ColdFeatures> segment ( new ColdFeatures () );
 
-	cd.confidence = 0;
-	cd.decision = cd.raw_score < 0 ? -1 : 0;
-	cd.raw_score = weight * int ( raw_score );
-	if ( DebugLevel > 0 ) {
-		stringstream ss;
-		ss << "?: '" << feature << "' = " << int ( raw_score );
-		cd.features.push_back( ss.str() );
-	} else {
-		if ( qm_ratio > 0.f ) cd.features.push_back( feature );
-	}
+		if ( ! segment->Open ( cold_file, cache_bytes ) ) {
+			setErrorMsg ( segment->getErrorMsg() );
+			return false;
+		}
 
-	return ( cd.confidence >= 0 );
-}
+		if ( replicas.empty() ) {
+			boost::shared_ptr<FeatureIndex> hot ( new FeatureIndex () );
+			if ( ! hot->Build ( features, false, -1 ) ) {
+				setErrorMsg ( "Failed to allocate feature index." );
+				return false;
+			}
+			replicas.push_back ( hot );
+		}
 
-CDecision::CDecision ()
-	: decision(0), raw_score(0), confidence(0), content(), features()
-{}
+		cold = segment;
+		{
+			boost::mutex::scoped_lock id_lock ( pending_lock );
+			if ( cold->getNextId() > next_feature_id )
+				next_feature_id = cold->getNextId();
+			if ( cold->getNextId() > model_ids )
+				model_ids = cold->getNextId();
+		}
+		resetDuplicates ();
 
-FeatureScores::FeatureScores ()
-	: score(0), relevance(0)
-{}
+		isSuccess = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::openColdFeatures" );
+	}
 
-SentimentClassifier::SentimentClassifier (
-		const string& feature_file, const string& stopword_file)
-	: UseQuestionMarks (true),
-	  RelevanceCutoff (1.0f), NeutralCutoff (1.0f), MaxFeatureSize (3),
-	  DebugLevel (0), error_msg (), TitleWeight (3), BodyWeight (1),
-	  URLWeight (1), isInited (false), features (), stopwords ()
-{
-	isInited =
-			readFeatures (feature_file);
-//			&& readStopwords (stopword_file);
+	return isSuccess;
 }
 
-bool SentimentClassifier::Classify (
-		const string& content, CDecision& cd)
-// return true if sentiment classification is successful; return false otherwise;
+bool SentimentClassifier::Update ( const string& content, int label )
+// learn from a labeled document; return false if the update is rejected
 {
-
-	if ( ! classifySentences ( 1, content, cd ) )
+	if ( label < -1 || label > 1 ) {
+		setErrorMsg ( "feedback label must be one of -1, 0, +1" );
 		return false;
+	}
 
-	if ( UseQuestionMarks ) {
-		CDecision cd_qm;
-		classifyQuestionMarks ( 1, content, cd_qm );
-
-		cd.features.push_back( cd_qm.features[0] );
-		cd.raw_score += cd_qm.raw_score;
+	string ucontent ( content );
 
-		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+	ucontent = regex_replace ( ucontent, urlx, " " );
 
-		// decision is based on sign of score
-		if ( cd.raw_score )
-			cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+	// sentences are enumerated exactly as classifySentences sees them
+	vector<string> sentences;
+	boost::split ( sentences, ucontent, boost::is_any_of ( ";?!" ) );
 
-		// decision is neutral if score doesn't exceed threshold
-		if ( abs ( cd.raw_score ) < min_sentiment )
-			cd.decision = 0;
+	FeaturesSet phrases;
+	for ( vector<string>::iterator sentence = sentences.begin();
+			sentence != sentences.end(); sentence++ ) {
+		string nsentence;
+		if ( normalizeContent ( *sentence, nsentence ) )
+			enumerateFeatures ( nsentence, phrases );
+		else return false;
 	}
 
-	return true;
+	return updateFeatures ( phrases, label );
 }
 
-bool SentimentClassifier::Classify (
+bool SentimentClassifier::Update (
 		const string& title, const string& body,
-		const string& url, CDecision& cd)
-// return true if sentiment classification is successful; return false otherwise;
+		const string& url, int label )
+// learn from a labeled title, body and url; return false if rejected
 {
+	if ( label < -1 || label > 1 ) {
+		setErrorMsg ( "feedback label must be one of -1, 0, +1" );
+		return false;
+	}
+
+	FeaturesSet phrases;
 	string ncontent;
-	CDecision cd_title;
+
 	if ( normalizeContent ( title, ncontent ) )
-		classifyGreedy ( TitleWeight, ncontent, cd_title );
+		enumerateFeatures ( ncontent, phrases );
 	else return false;
 
-	CDecision cd_body;
 	if ( normalizeContent ( body, ncontent ) )
-		classifyGreedy ( BodyWeight, ncontent, cd_body );
+		enumerateFeatures ( ncontent, phrases );
 	else return false;
 
-	CDecision cd_url;
 	if ( normalizeUrl ( url, ncontent ) )
-		classifyGreedy ( URLWeight, ncontent, cd_url );
+		enumerateFeatures ( ncontent, phrases );
 	else return false;
 
+	return updateFeatures ( phrases, label );
+}
+
+bool SentimentClassifier::publishUpdates ()
+// publish pending feature scores as a new layer of the overlay read by
+// Classify, merging it with the layers below that are not much larger
+{
+	bool isSuccess = false;
+
 	try {
-		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+		boost::mutex::scoped_lock lock ( pending_lock );
 
-		cd.content  =
-				cd_title.content + "+ " +
-				cd_body.content + "+ " +
-				cd_url.content;
+		if ( ! pending.empty() ) {
+			boost::shared_ptr<FeatureOverlay> next ( new FeatureOverlay () );
+			next->scores.swap ( pending );
 
-		cd.features.insert(cd.features.end(),
-						   cd_title.features.begin(),cd_title.features.end());
-		cd.features.insert(cd.features.end(),
-						   cd_body.features.begin(),cd_body.features.end());
-		cd.features.insert(cd.features.end(),
-						   cd_url.features.begin(),cd_url.features.end());
+			// newer scores win: insert keeps the entry already present
+			FeatureOverlayPtr base = boost::atomic_load ( &updates );
+			while ( base && base->scores.size() <= 2 * next->scores.size() ) {
+				next->scores.insert ( base->scores.begin(), base->scores.end() );
+				base = base->base;
+			}
+			next->base = base;
 
-		cd.raw_score =
-				cd_title.raw_score +
-				cd_body.raw_score +
-				cd_url.raw_score;
+			boost::atomic_store ( &updates, FeatureOverlayPtr ( next ) );
+			epoch ++;
+		}
+		pending_docs = 0;
+		published = boost::posix_time::microsec_clock::universal_time();
 
+		isSuccess = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::publishUpdates" );
+	}
 
-		if ( cd.features.size() == 0 ) {
-			cd.confidence = -1;
-			error_msg = "no decision could be reached";
-		} else {
-			// confidence is average relevance normalized over observed features
-			cd.confidence =
-				(	cd_title.confidence * TitleWeight +
-					cd_body.confidence * BodyWeight +
-					cd_url.confidence * URLWeight 	) /
-				(	TitleWeight + BodyWeight + URLWeight 	);
+	return isSuccess;
+}
 
-			// decision is based on sign of score
-			if ( cd.raw_score )
-				cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+bool SentimentClassifier::loadFeedback ( const string& feedback_file )
+// read feedback counts (phrase, then positive, neutral, negative and
+// feature id) and publish the scores they imply; identifiers now owned by
+// a loaded feature (the model was retrained since the snapshot) or by
+// another phrase are handed out anew
+{
+	bool isSuccess = false;
 
-			// decision is neutral if score doesn't exceed threshold
-			if ( abs ( cd.raw_score ) < min_sentiment )
-				cd.decision = 0;
+	string phrase, entry;
+	ifstream fs ( feedback_file.c_str() );
 
-			// decision is neutral if confidence is low
-			// if ( cd.confidence < min_sentiment ) cd.decision = 0;
+	if ( fs.good() ) {
+		try {
+			boost::hash<string> hasher;
+
+			map<int,string> owners;
+			for ( unsigned int i = 0; i < FeedbackShards; ++i ) {
+				boost::mutex::scoped_lock lock ( feedback[i].lock );
+				for ( FeedbackTable::const_iterator it = feedback[i].counts.begin();
+						it != feedback[i].counts.end(); it++ )
+					if ( it->second.id >= 0 )
+						owners[ it->second.id ] = it->first;
+			}
+
+			while ( getline ( fs, phrase, '\t' ) ) {
+				getline ( fs, entry, '\n' );
+
+				FeedbackCounts counts;
+				stringstream iss ( entry );
+				iss >> counts.positive >> counts.neutral >> counts.negative;
+				if ( ! ( iss >> counts.id ) )
+					counts.id = -1;
+
+				unsigned int support =
+					counts.positive + counts.neutral + counts.negative;
+				FeatureScores loaded;
+				bool known = baseFeature ( phrase, loaded );
+				if ( known ) {
+					counts.id = -1;
+				} else {
+					// keep identifiers handed out before the snapshot
+					// unless they have been taken since
+					boost::mutex::scoped_lock id_lock ( pending_lock );
+					map<int,string>::const_iterator owner =
+						owners.find ( counts.id );
+					if ( counts.id < model_ids || ( owner != owners.end() &&
+							owner->second != phrase ) )
+						counts.id = -1;
+
+					if ( counts.id >= next_feature_id )
+						next_feature_id = counts.id + 1;
+					else if ( counts.id < 0 &&
+							support >= FeedbackMinSupport )
+						counts.id = next_feature_id ++;
+
+					if ( counts.id >= 0 )
+						owners[ counts.id ] = phrase;
+				}
+
+				FeedbackShard& shard =
+					feedback[ hasher ( phrase ) % FeedbackShards ];
+				boost::mutex::scoped_lock lock ( shard.lock );
+				shard.counts[ phrase ] = counts;
+
+				if ( known || support >= FeedbackMinSupport ) {
+					FeatureScores fs = feedbackScores ( phrase, counts );
+					boost::mutex::scoped_lock pending_held ( pending_lock );
+					pending[ phrase ] = fs;
+				}
+			}
+
+			isSuccess = publishUpdates ();
+		} catch (...) {
+			setErrorMsg ( "error in SentimentClassifier::loadFeedback" );
 		}
+	} else {
+		setErrorMsg ( "Failed to open feedback file." );
+	}
 
-	} catch (...) {
-		cd.confidence = -1;
-		error_msg = "error in SentimentClassifier::Classify";
+	return isSuccess;
+}
+
+bool SentimentClassifier::saveFeedback ( const string& feedback_file )
+// write feedback counts to a temporary file, then rename it into place;
+// temporary files are unique so concurrent snapshots never share one
+{
+	bool isSuccess = false;
+
+	static boost::atomic<unsigned int> snapshots ( 0 );
+	stringstream tmp_name;
+	tmp_name << feedback_file << ".tmp." << getpid() << '.' << snapshots++;
+	string tmp_file = tmp_name.str();
+	ofstream fs ( tmp_file.c_str() );
+
+	if ( fs.good() ) {
+		for ( unsigned int i = 0; i < FeedbackShards; ++i ) {
+			boost::mutex::scoped_lock lock ( feedback[i].lock );
+			for ( FeedbackTable::const_iterator it = feedback[i].counts.begin();
+					it != feedback[i].counts.end(); it++ )
+				fs << it->first << '\t' << it->second.positive <<
+					' ' << it->second.neutral <<
+					' ' << it->second.negative <<
+					' ' << it->second.id << '\n';
+		}
+		fs.close();
+
+		isSuccess = ! fs.fail() &&
+			rename ( tmp_file.c_str(), feedback_file.c_str() ) == 0;
+		if ( ! isSuccess ) {
+			remove ( tmp_file.c_str() );
+			setErrorMsg ( "Failed to write feedback file." );
+		}
+	} else {
+		setErrorMsg ( "Failed to open feedback file for writing." );
 	}
 
-	return ( cd.confidence >= 0 );
+	return isSuccess;
 }
 
 bool SentimentClassifier::normalizeUrl (
@@ -359,7 +1792,7 @@ bool SentimentClassifier::normalizeUrl (
 
 		status = true;
 	} catch (...) {
-		error_msg = "error in SentimentClassifier::normalizeUrl";
+		setErrorMsg ( "error in SentimentClassifier::normalizeUrl" );
 	}
 
 	return status;
@@ -368,6 +1801,57 @@ bool SentimentClassifier::normalizeUrl (
 bool SentimentClassifier::normalizeContent (
 		const string& content, string& ncontent)
 // normalize punctuation and case of the content
+{
+	if ( ! workers || content.size() < ParallelThreshold )
+		return normalizeSegment ( content, ncontent );
+
+	// Pieces are cut just before a space that follows a non-space, so no
+	// pattern of normalizeSegment can match across a cut and every piece
+	// but the first starts with whitespace; joining the non-empty
+	// normalized pieces with one space then equals normalizing the whole.
+	unsigned int n = workers->getThreads() + 1;
+	vector<size_t> cuts ( 1, 0 );
+	for ( unsigned int k = 1; k < n; ++k ) {
+		size_t j = max ( cuts.back() + 1, content.size() * k / n );
+		while ( j < content.size() &&
+				! ( content[j] == ' ' && ! isspace ( (unsigned char) content[j-1] ) ) )
+			++j;
+		if ( j >= content.size() ) break;
+		cuts.push_back ( j );
+	}
+	cuts.push_back ( content.size() );
+
+	unsigned int pieces = cuts.size() - 1;
+	vector<string> parts ( pieces ), nparts ( pieces );
+	vector<char> statuses ( pieces, 1 );
+	vector<WorkerPool::Task> tasks;
+	for ( unsigned int k = 0; k < pieces; ++k ) {
+		parts[k] = content.substr ( cuts[k], cuts[k+1] - cuts[k] );
+		tasks.push_back ( boost::bind ( &SentimentClassifier::normalizeTask,
+				this, &parts[k], &nparts[k], &statuses[k] ) );
+	}
+	workers->Run ( tasks );
+
+	ncontent.clear();
+	for ( unsigned int k = 0; k < pieces; ++k ) {
+		if ( ! statuses[k] ) return false;
+		if ( nparts[k].empty() ) continue;
+		if ( ! ncontent.empty() ) ncontent += " ";
+		ncontent += nparts[k];
+	}
+
+	return true;
+}
+
+void SentimentClassifier::normalizeTask ( const string* content,
+		string* ncontent, char* status )
+{
+	*status = normalizeSegment ( *content, *ncontent );
+}
+
+bool SentimentClassifier::normalizeSegment (
+		const string& content, string& ncontent)
+// normalize punctuation and case of one piece of content
 {
 	bool status = false;
 	try {
@@ -396,7 +1880,7 @@ bool SentimentClassifier::normalizeContent (
 
 		status = true;
 	} catch (...) {
-		error_msg = "error in SentimentClassifier::normalizeContent";
+		setErrorMsg ( "error in SentimentClassifier::normalizeSegment" );
 	}
 
 	return status;
@@ -422,8 +1906,21 @@ bool SentimentClassifier::readFeatures ( const string& features_file )
 			isSuccess = parseFeature ( phrase, entry );
 			if ( !isSuccess ) break;
 		}
+
+		// identifiers follow phrase order so they are stable per model;
+		// identifiers given in the file (tiered models) are kept
+		for ( FeaturesTable::iterator it = features.begin();
+				it != features.end(); it++ )
+			if ( it->second.id >= next_feature_id )
+				next_feature_id = it->second.id + 1;
+
+		for ( FeaturesTable::iterator it = features.begin();
+				it != features.end(); it++ )
+			if ( it->second.id < 0 )
+				it->second.id = next_feature_id ++;
+		model_ids = next_feature_id;
 	} else {
-		error_msg = "Failed to open features file.";
+		setErrorMsg ( "Failed to open features file." );
 	}
 
 	return isSuccess;
@@ -435,17 +1932,19 @@ bool SentimentClassifier::parseFeature ( string& phrase, string& entry )
 
 	try { 	   // phrase is added to FeatureTable
 
-		int score_data;
+		int score_data, id_data;
 		stringstream iss (entry);
 		iss >> score_data;
 
 		features[phrase].score = score_data;
 		features[phrase].relevance = abs ( score_data );
+		if ( iss >> id_data )
+			features[phrase].id = id_data;
 
 		isSuccess = true;
 
 	} catch (...) {
-		error_msg = "error in SentimentClassifier::parseFeature";
+		setErrorMsg ( "error in SentimentClassifier::parseFeature" );
 	}
 
 	return isSuccess;
@@ -465,7 +1964,7 @@ bool SentimentClassifier::readStopwords ( const string& stopwords_file )
 		}
 		isSuccess = true;
 	} else {
-		error_msg = "Failed to open stopwords file.";
+		setErrorMsg ( "Failed to open stopwords file." );
 	}
 
 	return isSuccess;
@@ -474,6 +1973,7 @@ bool SentimentClassifier::readStopwords ( const string& stopwords_file )
 void SentimentClassifier::setUseQuestionMarks ( bool qm )
 {
 	UseQuestionMarks = qm;
+	resetDuplicates ();
 }
 
 bool SentimentClassifier::getUseQuestionMarks () const
@@ -484,6 +1984,8 @@ bool SentimentClassifier::getUseQuestionMarks () const
 void SentimentClassifier::setRelevanceCutoff ( float rc )
 {
 	RelevanceCutoff = rc;
+	resolveThresholds ();
+	resetDuplicates ();
 }
 
 float SentimentClassifier::getRelevanceCutoff () const
@@ -494,6 +1996,8 @@ float SentimentClassifier::getRelevanceCutoff () const
 void SentimentClassifier::setNeutralCutoff ( float nc )
 {
 	NeutralCutoff = nc;
+	resolveThresholds ();
+	resetDuplicates ();
 }
 
 float SentimentClassifier::getNeutralCutoff () const
@@ -504,6 +2008,7 @@ float SentimentClassifier::getNeutralCutoff () const
 void SentimentClassifier::setMaxFeatureSize ( unsigned int mfs )
 {
 	MaxFeatureSize = mfs;
+	resetDuplicates ();
 }
 
 unsigned int SentimentClassifier::getMaxFeatureSize () const
@@ -514,6 +2019,7 @@ unsigned int SentimentClassifier::getMaxFeatureSize () const
 void SentimentClassifier::setDebugLevel ( unsigned int dl )
 {
 	DebugLevel = dl;
+	resetDuplicates ();
 }
 
 unsigned int SentimentClassifier::getDebugLevel () const
@@ -521,7 +2027,156 @@ unsigned int SentimentClassifier::getDebugLevel () const
 	return DebugLevel;
 }
 
+void SentimentClassifier::resolveThresholds ()
+// integer thresholds in score units, resolved once per cutoff change
+{
+	relevance_threshold = int ( FeatureScoreScale * RelevanceCutoff );
+	sentiment_threshold = int ( FeatureScoreScale * NeutralCutoff );
+}
+
+void SentimentClassifier::setFeedbackMinSupport ( unsigned int fms )
+{
+	FeedbackMinSupport = fms;
+}
+
+unsigned int SentimentClassifier::getFeedbackMinSupport () const
+{
+	return FeedbackMinSupport;
+}
+
+void SentimentClassifier::setUpdateEpochSize ( unsigned int ues )
+{
+	UpdateEpochSize = ues;
+}
+
+unsigned int SentimentClassifier::getUpdateEpochSize () const
+{
+	return UpdateEpochSize;
+}
+
+void SentimentClassifier::setUpdateEpochInterval ( unsigned int msec )
+// end an epoch this long after the last one even if it is not full; 0 ends
+// epochs by size only
+{
+	UpdateEpochInterval = msec;
+}
+
+unsigned int SentimentClassifier::getUpdateEpochInterval () const
+{
+	return UpdateEpochInterval;
+}
+
+void SentimentClassifier::setFeedbackCapacity ( unsigned int fc )
+{
+	FeedbackCapacity = fc;
+}
+
+unsigned int SentimentClassifier::getFeedbackCapacity () const
+{
+	return FeedbackCapacity;
+}
+
+unsigned int SentimentClassifier::getUpdateEpoch () const
+{
+	return epoch.load ();
+}
+
+void SentimentClassifier::setFeedbackSnapshot ( const string& file,
+		unsigned int interval )
+{
+	FeedbackSnapshotFile = file;
+	FeedbackSnapshotInterval = interval;
+}
+
+void SentimentClassifier::setWorkerPool (
+		const boost::shared_ptr<WorkerPool>& wp )
+{
+	workers = wp;
+}
+
+void SentimentClassifier::setParallelThreshold ( unsigned int pt )
+{
+	ParallelThreshold = pt;
+}
+
+unsigned int SentimentClassifier::getParallelThreshold () const
+{
+	return ParallelThreshold;
+}
+
+void SentimentClassifier::setNearDuplicates ( unsigned int max_distance,
+		size_t max_bytes )
+// reuse decisions of documents within max_distance bits of SimHash;
+// max_bytes of 0 disables near-duplicate detection
+{
+	if ( max_bytes > 0 )
+		duplicates.reset ( new NearDuplicateIndex ( max_distance, max_bytes ) );
+	else
+		duplicates.reset ();
+}
+
+void SentimentClassifier::setReferenceEngine ( bool re )
+// classify with the original sequential implementation
+{
+	ReferenceEngine = re;
+}
+
+bool SentimentClassifier::getReferenceEngine () const
+{
+	return ReferenceEngine;
+}
+
+unsigned long SentimentClassifier::getDuplicatesChecked () const
+{
+	return duplicates ? duplicates->getChecked() : 0;
+}
+
+unsigned long SentimentClassifier::getDuplicatesInherited () const
+{
+	return duplicates ? duplicates->getInherited() : 0;
+}
+
+unsigned int SentimentClassifier::getModelReplicas () const
+{
+	return replicas.size();
+}
+
+bool SentimentClassifier::getModelRegion ( unsigned int replica,
+		PlacedRegion& region ) const
+// describe memory of a feature index replica; false if there is none
+{
+	if ( replica >= replicas.size() )
+		return false;
+
+	region = replicas[replica]->getRegion();
+	return true;
+}
+
+bool SentimentClassifier::getColdCounters ( ColdCounters& counters ) const
+// copy cold tier counters; return false if no cold segment is open
+{
+	if ( ! cold )
+		return false;
+
+	counters = cold->getCounters();
+	return true;
+}
+
+void SentimentClassifier::resetDuplicates ()
+// decisions made under other options must not be reused
+{
+	if ( duplicates )
+		duplicates->Clear ();
+}
+
+void SentimentClassifier::setErrorMsg ( const string& msg )
+{
+	boost::mutex::scoped_lock lock ( error_lock );
+	error_msg = msg;
+}
+
 string SentimentClassifier::getErrorMsg () const
 {
+	boost::mutex::scoped_lock lock ( error_lock );
 	return error_msg;
 }
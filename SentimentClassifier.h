@@ -12,7 +12,12 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
 //#include <boost/unordered_map.hpp>
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 using namespace std;
 
@@ -35,6 +40,48 @@ struct CDecision
 
 	vector<string> features;
 	// features contributing classification decision
+
+	vector<int> feature_scores;
+	// weighted score contributed by each entry of features
+
+	bool inherited;
+	// decision was copied from a near-duplicate document
+
+	unsigned int truncated;
+	// BudgetLimit bits of the budgets that ran out; 0 if input was complete
+
+	size_t bytes_processed;
+	unsigned int tokens_processed;
+	unsigned int sentences_processed;
+	// input classified by a bounded Classify, in units of ClassifyBudget
+};
+
+struct ClassifyBudget
+// data structure for per-call limits of a bounded Classify; 0 is unlimited
+{
+	ClassifyBudget();
+
+	size_t max_bytes;
+	// input bytes, counted over title, body and url in that order
+
+	unsigned int max_tokens;
+	// whitespace-separated words of input
+
+	unsigned int max_sentences;
+	// sentences, split at ';', '?' and '!' (single content only)
+
+	unsigned int deadline_usec;
+	// wall-clock time of the call in microseconds, checked between
+	// sentences and fields
+};
+
+enum BudgetLimit
+// bits of CDecision::truncated
+{
+	BudgetBytes = 1,
+	BudgetTokens = 2,
+	BudgetSentences = 4,
+	BudgetDeadline = 8
 };
 
 struct FeatureScores
@@ -47,14 +94,88 @@ struct FeatureScores
 
 	int relevance;
 	// relevance score of feature
+
+	int id;
+	// feature identifier; dense index assigned when the phrase is loaded
+};
+
+struct FeedbackCounts
+// data structure for storing labeled feedback counts of a feature
+{
+	FeedbackCounts();
+
+	int positive;
+	// number of feedback documents labeled +1 containing the feature
+
+	int neutral;
+	// number of feedback documents labeled 0 containing the feature
+
+	int negative;
+	// number of feedback documents labeled -1 containing the feature
+
+	int id;
+	// feature identifier once admitted to the model; -1 until then
+};
+
+enum FeatureField
+// fields of a document that matched features are exported from
+{
+	ContentField = 0,
+	TitleField = 0,
+	BodyField = 1,
+	UrlField = 2
+};
+
+struct SparseFeature
+// data structure for one exported feature of a document
+{
+	unsigned int id;
+	// feature identifier
+
+	unsigned int field;
+	// FeatureField the feature was matched in
+
+	int count;
+	// number of times the feature was matched in the field
+
+	int score;
+	// weighted feature score, as contributed to raw_score
 };
 
+typedef vector<SparseFeature> SparseVector;
+
 //typedef boost::unordered_map<string,int> StopwordsTable;
 //typedef boost::unordered_map<string,FeatureScores> FeaturesTable;
 
 typedef map<string,int> StopwordsTable;
 typedef map<string,int> FeaturesCount;
 typedef map<string,FeatureScores> FeaturesTable;
+typedef map<string,FeedbackCounts> FeedbackTable;
+typedef set<string> FeaturesSet;
+
+struct FeatureOverlay
+// data structure for published online updates: scores of recent epochs
+// over the overlay they were published on, newest layer first
+{
+	FeatureOverlay();
+	bool Find ( const string& phrase, FeatureScores& fs ) const;
+	void Flatten ( FeaturesTable& table ) const;
+
+	FeaturesTable scores;
+	// scores published in this layer, shadowing those of base
+
+	boost::shared_ptr<const FeatureOverlay> base;
+	// older layers, each more than twice the size of the one above it
+};
+
+typedef boost::shared_ptr<const FeatureOverlay> FeatureOverlayPtr;
+
+class WorkerPool;
+class NearDuplicateIndex;
+class ColdFeatures;
+struct ColdCounters;
+class FeatureIndex;
+struct PlacedRegion;
 
 class SentimentClassifier {
 public:
@@ -64,18 +185,60 @@ public:
 	bool Classify ( const string& input, CDecision& cd );
 	bool Classify ( const string& title, const string& body,
 				    const string& url, CDecision& cd );
+	bool Classify ( const string& input, const ClassifyBudget& budget,
+					CDecision& cd );
+	bool Classify ( const string& title, const string& body,
+				    const string& url, const ClassifyBudget& budget,
+				    CDecision& cd );
+
+	bool Update ( const string& input, int label );
+	bool Update ( const string& title, const string& body,
+				  const string& url, int label );
+	bool Extract ( const string& input, SparseVector& sv );
+	bool Extract ( const string& title, const string& body,
+				   const string& url, SparseVector& sv );
+	bool saveFeatureIds ( const string& ids_file ) const;
+
+	bool publishUpdates ();
+	bool loadFeedback ( const string& feedback_file );
+	bool saveFeedback ( const string& feedback_file );
+	bool saveTiers ( const string& hot_file, const string& cold_file,
+					 size_t hot_bytes, const string& ranking_file );
+	bool openColdFeatures ( const string& cold_file, size_t cache_bytes );
+	bool setModelPlacement ( bool huge_pages, bool node_replicas );
 
 	void setUseQuestionMarks ( bool qm );
 	void setRelevanceCutoff ( float rc );
 	void setNeutralCutoff ( float nc );
 	void setMaxFeatureSize ( unsigned int mfs );
 	void setDebugLevel ( unsigned int dl );
+	void setFeedbackMinSupport ( unsigned int fms );
+	void setUpdateEpochSize ( unsigned int ues );
+	void setUpdateEpochInterval ( unsigned int msec );
+	void setFeedbackCapacity ( unsigned int fc );
+	void setFeedbackSnapshot ( const string& file, unsigned int interval );
+	void setWorkerPool ( const boost::shared_ptr<WorkerPool>& wp );
+	void setParallelThreshold ( unsigned int pt );
+	void setNearDuplicates ( unsigned int max_distance, size_t max_bytes );
+	void setReferenceEngine ( bool re );
 
 	bool getUseQuestionMarks () const;
 	float getRelevanceCutoff () const;
 	float getNeutralCutoff ( ) const;
 	unsigned int getMaxFeatureSize () const;
 	unsigned int getDebugLevel () const;
+	unsigned int getFeedbackMinSupport () const;
+	unsigned int getUpdateEpochSize () const;
+	unsigned int getUpdateEpochInterval () const;
+	unsigned int getFeedbackCapacity () const;
+	unsigned int getUpdateEpoch () const;
+	unsigned int getParallelThreshold () const;
+	bool getReferenceEngine () const;
+	unsigned long getDuplicatesChecked () const;
+	unsigned long getDuplicatesInherited () const;
+	bool getColdCounters ( ColdCounters& counters ) const;
+	unsigned int getModelReplicas () const;
+	bool getModelRegion ( unsigned int replica, PlacedRegion& region ) const;
 	string getErrorMsg () const;
 
 private:
@@ -84,7 +247,16 @@ private:
 	float NeutralCutoff;
 	unsigned int MaxFeatureSize;
 	unsigned int DebugLevel;
+	unsigned int FeedbackMinSupport;
+	unsigned int UpdateEpochSize;
+	unsigned int UpdateEpochInterval;
+	unsigned int FeedbackCapacity;
+	unsigned int FeedbackSnapshotInterval;
+	string FeedbackSnapshotFile;
+	unsigned int ParallelThreshold;
+	bool ReferenceEngine;
 	string error_msg;
+	mutable boost::mutex error_lock;
 
 	int TitleWeight;
 	int BodyWeight;
@@ -94,19 +266,147 @@ private:
 	bool readFeatures ( const string& features_file );
 	bool readStopwords ( const string& stopwords_file );
 	bool parseFeature ( string& phrase, string& entry );
+	void setErrorMsg ( const string& msg );
+	struct BudgetState;
+
+	bool classifyContent ( const string& content, CDecision& cd,
+			BudgetState* budget );
+	bool classifyTitleBodyUrl ( const string& title, const string& body,
+			const string& url, CDecision& cd, BudgetState* budget );
+	void resetDuplicates ();
+
+	// reference engine; see SentimentClassifierReference.cpp
+	bool referenceClassify ( const string& content, CDecision& cd );
+	bool referenceClassify ( const string& title, const string& body,
+			const string& url, CDecision& cd );
+	bool referenceSentences ( int weight, const string& ucontent,
+			const FeatureOverlay& overlay, CDecision& cd );
+	bool referenceGreedy ( int weight, string& ncontent,
+			const FeatureOverlay& overlay, CDecision& cd );
+	bool referenceQuestionMarks ( int weight, const string& ucontent,
+			CDecision& cd );
+	bool referenceNormalize ( const string& content, string& ncontent );
+	bool referenceNormalizeUrl ( const string& content, string& ncontent );
+	bool referenceFeature ( const FeatureOverlay& overlay,
+			const string& phrase, FeatureScores& fs ) const;
 	bool normalizeContent ( const string& content, string& ncontent );
+	bool normalizeSegment ( const string& content, string& ncontent );
 	bool normalizeUrl ( const string& content, string& ncontent );
-	bool classifyGreedy ( int weight, string& ncontent, CDecision& cd );
+	bool classifyGreedy ( int weight, string& ncontent,
+			const FeatureOverlay& overlay, CDecision& cd,
+			const FeaturesCount* matched = NULL );
+	bool classifyPieces ( int weight, const string& content, size_t begin,
+			bool sentences, bool is_url, const FeatureOverlay& overlay,
+			CDecision& cd, BudgetState* budget, size_t& end );
 	bool classifySentences ( int weight, const string& ucontent,
-			CDecision& cd );
+			const FeatureOverlay& overlay, CDecision& cd,
+			BudgetState* budget );
+	void classifySegment ( int weight, const vector<string>* sentences,
+			unsigned int begin, unsigned int end,
+			const FeatureOverlay* overlay, CDecision* cd, char* status );
+	void classifyField ( int weight, const string* content, bool is_url,
+			const FeatureOverlay* overlay, CDecision* cd, char* status );
+	void normalizeTask ( const string* content, string* ncontent,
+			char* status );
 	bool classifyQuestionMarks ( int weight, const string& ucontent,
 			CDecision& cd );
 
+	void matchFeatures ( const string& ncontent,
+			const FeatureOverlay& overlay, FeaturesCount& fc ) const;
+	unsigned int matchAt ( const vector<string>& tokens, unsigned int i,
+			const FeatureOverlay& overlay, int cutoff, string& feature ) const;
+	static float featureWeight ( int count );
+	int featureScore ( int count, int score ) const;
+	void resolveThresholds ();
+
+	struct MatchSegment {
+		unsigned int begin;
+		unsigned int end;
+		unsigned int next;
+		vector<unsigned int> positions;
+		vector<unsigned int> match_positions;
+		vector<string> match_features;
+	};
+
+	void matchSegment ( const vector<string>* tokens,
+			const FeatureOverlay* overlay, MatchSegment* seg ) const;
+	void extractFeatures ( int weight, unsigned int field,
+			const string& ncontent, const FeatureOverlay& overlay,
+			SparseVector& sv ) const;
+	bool lookupFeature ( const FeatureOverlay& overlay,
+			const string& phrase, FeatureScores& fs ) const;
+	bool baseFeature ( const string& phrase, FeatureScores& fs ) const;
+	const FeatureIndex& localReplica () const;
+	static string makePhrase ( const vector<string>& tokens,
+			unsigned int i, unsigned int t );
+	void enumerateFeatures ( const string& ncontent,
+			FeaturesSet& phrases ) const;
+	bool updateFeatures ( const FeaturesSet& phrases, int label );
+	FeatureScores feedbackScores ( const string& phrase,
+			const FeedbackCounts& counts ) const;
+
 	FeaturesTable features;
 	StopwordsTable stopwords;
 
+	// Features outside the hot table live in a block-compressed segment
+	// on disk; lookups miss the hot table first. Unset unless opened.
+	boost::shared_ptr<ColdFeatures> cold;
+
+	// Copies of features in flat hash tables, optionally in huge pages and
+	// one per NUMA node; lookups read the replica of the calling thread's
+	// node. Empty unless placed; features stays the table of record.
+	vector< boost::shared_ptr<const FeatureIndex> > replicas;
+
+	// Inputs of at least ParallelThreshold bytes are split into segments
+	// classified on the worker pool; results equal the sequential path.
+	boost::shared_ptr<WorkerPool> workers;
+
+	// Recent decisions by SimHash of their input; documents within a few
+	// bits of a known one reuse its decision. Unset unless enabled.
+	boost::shared_ptr<NearDuplicateIndex> duplicates;
+
+	// Online updates: labeled counts are sharded by phrase hash so
+	// concurrent Update calls rarely contend; recomputed scores collect
+	// in a pending table and are published to readers as a new immutable
+	// overlay layer swapped in atomically at the end of each epoch.
+	// Layers are merged only when one grows to half of the one below, so
+	// a score is copied a logarithmic number of times, not per epoch.
+	// Counts of phrases outside the model and below FeedbackMinSupport
+	// are pruned once a shard outgrows its share of FeedbackCapacity.
+	static const unsigned int FeedbackShards = 16;
+
+	struct FeedbackShard {
+		FeedbackShard();
+		boost::mutex lock;
+		FeedbackTable counts;
+		size_t prune_at;
+		// counts are pruned again once the table outgrows this
+	};
+
+	FeedbackShard feedback[ FeedbackShards ];
+	void pruneFeedback ( FeedbackShard& shard ) const;
+	FeatureOverlayPtr updates;
+	mutable boost::mutex pending_lock;
+	FeaturesTable pending;
+	unsigned int pending_docs;
+	boost::posix_time::ptime published;
+	unsigned int snapshot_docs;
+	boost::atomic<unsigned int> epoch;
+	// read without pending_lock by Classify; bumped after the overlay is
+	// stored, so a reader seeing an epoch also sees its overlay
+	int next_feature_id;
+	int model_ids;
+	// identifiers below model_ids belong to loaded features
+
 	// This is an arbitrary scaling unit. Revisit later.
 	static const float FeatureScoreScale = 288.f; // = 200/ln(2)
+
+	// Feature weights for counts below FeatureWeights are tabulated so
+	// scoring needs no log(); cutoffs in score units are kept resolved.
+	static const int FeatureWeights = 64;
+	float feature_weights[ FeatureWeights ];
+	int relevance_threshold;
+	int sentiment_threshold;
 };
 
 #endif /* SENTIMENTCLASSIFIER_H_ */
@@ -0,0 +1,383 @@
+/*
+ * SentimentClassifierReference.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+// Reference engine: the original sequential implementation, kept as the
+// oracle faster paths are compared against. It differs from the original
+// only in looking up online updates, recording feature_scores, not
+// reading a missing question mark feature and printing no debug traces.
+// Features come from the loaded table itself, never from the hash table
+// replicas or the cold tier, so those are checked against it too.
+// Do not optimize this file.
+
+#include "SentimentClassifier.h"
+
+#include <math.h>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+#include <boost/xpressive/xpressive.hpp>
+
+using namespace boost::xpressive;
+
+bool SentimentClassifier::referenceFeature ( const FeatureOverlay& overlay,
+		const string& phrase, FeatureScores& fs ) const
+// copy scores of phrase from online updates, else the loaded table
+{
+	if ( overlay.Find ( phrase, fs ) )
+		return true;
+
+	FeaturesTable::const_iterator it = features.find ( phrase );
+	if ( it == features.end() )
+		return false;
+
+	fs = it->second;
+	return true;
+}
+
+bool SentimentClassifier::referenceSentences ( int weight,
+		const string& ucontent, const FeatureOverlay& overlay, CDecision& cd )
+{
+	string content ( ucontent );
+
+	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+	content = regex_replace ( content, urlx, " " );
+
+	vector<string> sentences;
+	boost::split ( sentences, content, boost::is_any_of ( ";?!" ) );
+
+	for ( vector<string>::iterator sentence = sentences.begin();
+			sentence != sentences.end(); sentence++ ) {
+		CDecision cd_s;
+		string nsentence;
+
+		if ( referenceNormalize ( *sentence, nsentence ) )
+			referenceGreedy ( weight, nsentence, overlay, cd_s );
+		else return false;
+
+		cd.content += cd_s.content + "; ";
+		cd.raw_score += cd_s.raw_score;
+		cd.confidence += cd_s.confidence;
+		cd.features.insert(cd.features.end(),
+						   cd_s.features.begin(),cd_s.features.end());
+		cd.feature_scores.insert(cd.feature_scores.end(),
+						   cd_s.feature_scores.begin(),cd_s.feature_scores.end());
+	}
+
+	if ( cd.features.size() == 0 ) {
+		cd.confidence = -1;
+		setErrorMsg ( "no decision could be reached" );
+	} else {
+		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+
+		// confidence is average relevance normalized over observed features
+		cd.confidence /= int ( sentences.size() );
+
+		// decision is based on sign of score
+		if ( cd.raw_score )
+			cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+
+		// decision is neutral if score doesn't exceed threshold
+		if ( abs ( cd.raw_score ) < min_sentiment )
+			cd.decision = 0;
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+bool SentimentClassifier::referenceGreedy ( int weight,
+		string& content, const FeatureOverlay& overlay, CDecision& cd )
+{
+
+	try {
+		int cutoff = int ( FeatureScoreScale * RelevanceCutoff );
+		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+
+		cd.content = content;
+
+		vector<string> tokens;
+		boost::split ( tokens, content, boost::is_any_of ( " " ) );
+
+		FeaturesCount fc;
+
+		for ( unsigned int i=0; i < tokens.size(); ++i ) {
+			string test_feature = "";
+			unsigned int s = MaxFeatureSize;
+
+			for ( ; s > 0; --s ) {
+				stringstream ss;
+				unsigned int t = i+s;
+				if ( t <= tokens.size() ) {
+					ss << tokens[i];
+					for ( unsigned int u = i+1 ; u < t ; ++u )
+						ss << " " << tokens[u];
+
+					FeatureScores fs;
+					if ( referenceFeature ( overlay, ss.str(), fs ) &&
+							fs.relevance > cutoff ) {
+						test_feature = ss.str();
+						break;
+					}
+				}
+			}
+
+			if ( test_feature != "" ) {
+				if ( fc.find( test_feature ) == fc.end() )
+					fc[test_feature] = 0;
+				fc[test_feature] ++;
+
+				i += s-1;
+			}
+		}
+
+		for ( FeaturesCount::const_iterator it = fc.begin();
+				it != fc.end(); it++ ) {
+
+			FeatureScores fs;
+			referenceFeature ( overlay, it->first, fs );
+
+			float feature_weight =
+				( 1.f + log ( float ( it->second ) ) / log ( 2.f ) );
+
+			int feature_score =
+				int ( feature_weight * float ( fs.score ) );
+
+			cd.raw_score += weight * feature_score;
+
+			cd.confidence += fs.score;
+
+			if ( DebugLevel > 0 ) {
+				stringstream ss;
+				ss << it->first << " *";
+				ss << it->second << " = ";
+				ss << feature_score;
+				cd.features.push_back( ss.str() );
+			} else {
+				cd.features.push_back( it->first );
+			}
+			cd.feature_scores.push_back( weight * feature_score );
+
+		}
+
+		if ( cd.features.size() == 0 ) {
+			cd.confidence = -1;
+			setErrorMsg ( "no decision could be reached" );
+		} else {
+			// confidence is average relevance normalized over observed features
+			cd.confidence /= int ( cd.features.size() );
+			cd.confidence = abs ( cd.confidence );
+
+			// decision is based on sign of score
+			if ( cd.raw_score )
+				cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+
+			// decision is neutral if score doesn't exceed threshold
+			if ( abs ( cd.raw_score ) < min_sentiment )
+				cd.decision = 0;
+		}
+
+	} catch (...) {
+		cd.confidence = -1;
+		setErrorMsg ( "error in SentimentClassifier::referenceGreedy" );
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+bool SentimentClassifier::referenceQuestionMarks ( int weight,
+		const string& ucontent, CDecision& cd)
+{
+	string feature ( ucontent );
+
+	sregex urlx = sregex::compile( "(http:[\\/\\w\\d\\.\\=\\&\\?]+)" );
+	feature = regex_replace ( feature, urlx, " " );
+
+	float qm_ratio = float ( feature.size() );
+
+	sregex non_qmx = sregex::compile( "[^\\?]" );
+	feature = regex_replace ( feature, non_qmx, "" );
+
+	qm_ratio = float ( feature.size() ) / qm_ratio;
+	float raw_score = 0.f;
+	if ( qm_ratio > 0.001f )
+		raw_score = FeatureScoreScale * ( -156.f * qm_ratio - 0.3f );
+
+	cd.confidence = 0;
+	cd.decision = cd.raw_score < 0 ? -1 : 0;
+	cd.raw_score = weight * int ( raw_score );
+	if ( DebugLevel > 0 ) {
+		stringstream ss;
+		ss << "?: '" << feature << "' = " << int ( raw_score );
+		cd.features.push_back( ss.str() );
+		cd.feature_scores.push_back( cd.raw_score );
+	} else if ( qm_ratio > 0.f ) {
+		cd.features.push_back( feature );
+		cd.feature_scores.push_back( cd.raw_score );
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+bool SentimentClassifier::referenceClassify (
+		const string& content, CDecision& cd)
+{
+	FeatureOverlayPtr overlay = boost::atomic_load ( &updates );
+
+	if ( ! referenceSentences ( 1, content, *overlay, cd ) )
+		return false;
+
+	if ( UseQuestionMarks ) {
+		CDecision cd_qm;
+		referenceQuestionMarks ( 1, content, cd_qm );
+
+		if ( cd_qm.features.size() > 0 ) {
+			cd.features.push_back( cd_qm.features[0] );
+			cd.feature_scores.push_back( cd_qm.feature_scores[0] );
+		}
+		cd.raw_score += cd_qm.raw_score;
+
+		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+
+		// decision is based on sign of score
+		if ( cd.raw_score )
+			cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+
+		// decision is neutral if score doesn't exceed threshold
+		if ( abs ( cd.raw_score ) < min_sentiment )
+			cd.decision = 0;
+	}
+
+	return true;
+}
+
+bool SentimentClassifier::referenceClassify (
+		const string& title, const string& body,
+		const string& url, CDecision& cd)
+{
+	FeatureOverlayPtr overlay = boost::atomic_load ( &updates );
+
+	string ncontent;
+	CDecision cd_title;
+	if ( referenceNormalize ( title, ncontent ) )
+		referenceGreedy ( TitleWeight, ncontent, *overlay, cd_title );
+	else return false;
+
+	CDecision cd_body;
+	if ( referenceNormalize ( body, ncontent ) )
+		referenceGreedy ( BodyWeight, ncontent, *overlay, cd_body );
+	else return false;
+
+	CDecision cd_url;
+	if ( referenceNormalizeUrl ( url, ncontent ) )
+		referenceGreedy ( URLWeight, ncontent, *overlay, cd_url );
+	else return false;
+
+	try {
+		int min_sentiment = int ( FeatureScoreScale * NeutralCutoff );
+
+		cd.content  =
+				cd_title.content + "+ " +
+				cd_body.content + "+ " +
+				cd_url.content;
+
+		cd.features.insert(cd.features.end(),
+						   cd_title.features.begin(),cd_title.features.end());
+		cd.features.insert(cd.features.end(),
+						   cd_body.features.begin(),cd_body.features.end());
+		cd.features.insert(cd.features.end(),
+						   cd_url.features.begin(),cd_url.features.end());
+
+		cd.feature_scores.insert(cd.feature_scores.end(),
+				cd_title.feature_scores.begin(),cd_title.feature_scores.end());
+		cd.feature_scores.insert(cd.feature_scores.end(),
+				cd_body.feature_scores.begin(),cd_body.feature_scores.end());
+		cd.feature_scores.insert(cd.feature_scores.end(),
+				cd_url.feature_scores.begin(),cd_url.feature_scores.end());
+
+		cd.raw_score =
+				cd_title.raw_score +
+				cd_body.raw_score +
+				cd_url.raw_score;
+
+		if ( cd.features.size() == 0 ) {
+			cd.confidence = -1;
+			setErrorMsg ( "no decision could be reached" );
+		} else {
+			// confidence is average relevance normalized over observed features
+			cd.confidence =
+				(	cd_title.confidence * TitleWeight +
+					cd_body.confidence * BodyWeight +
+					cd_url.confidence * URLWeight 	) /
+				(	TitleWeight + BodyWeight + URLWeight 	);
+
+			// decision is based on sign of score
+			if ( cd.raw_score )
+				cd.decision = ( cd.raw_score < 0 ) ? -1 : 1;
+
+			// decision is neutral if score doesn't exceed threshold
+			if ( abs ( cd.raw_score ) < min_sentiment )
+				cd.decision = 0;
+		}
+
+	} catch (...) {
+		cd.confidence = -1;
+		setErrorMsg ( "error in SentimentClassifier::referenceClassify" );
+	}
+
+	return ( cd.confidence >= 0 );
+}
+
+bool SentimentClassifier::referenceNormalizeUrl (
+		const string& content, string& ncontent)
+{
+	bool status = false;
+	try {
+		ncontent = boost::to_lower_copy ( content );
+
+		sregex httpx = sregex::compile( "http:\\/\\/[^\\/]+\\/" );
+		ncontent = regex_replace ( ncontent, httpx, "" );
+
+		sregex punctx = sregex::compile( "[^\\w\\d]+" );
+		ncontent = regex_replace ( ncontent, punctx, " " );
+
+		status = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::referenceNormalizeUrl" );
+	}
+
+	return status;
+}
+
+bool SentimentClassifier::referenceNormalize (
+		const string& content, string& ncontent)
+{
+	bool status = false;
+	try {
+		ncontent = boost::to_lower_copy ( content );
+
+		sregex hashx = sregex::compile( "^#\\S+| #\\S+" );
+		ncontent = regex_replace ( ncontent, hashx, " " );
+
+		sregex atx = sregex::compile( "^@\\S+| @\\S+" );
+		ncontent = regex_replace ( ncontent, atx, " " );
+
+		sregex urlx = sregex::compile( "http:[\\/\\w\\d\\.\\=\\&\\?]+" );
+		ncontent = regex_replace ( ncontent, urlx, "" );
+
+		sregex symbolx = sregex::compile( "[^a-z0-9\\']" );
+		ncontent = regex_replace ( ncontent, symbolx, " " );
+
+		sregex wsx = sregex::compile( "\\s+" );
+		ncontent = regex_replace ( ncontent, wsx, " " );
+
+		sregex trimx = sregex::compile( "^\\s+|\\s+$" );
+		ncontent = regex_replace ( ncontent, trimx, "" );
+
+		status = true;
+	} catch (...) {
+		setErrorMsg ( "error in SentimentClassifier::referenceNormalize" );
+	}
+
+	return status;
+}
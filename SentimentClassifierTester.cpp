@@ -12,8 +12,16 @@
 
 // See: http://tclap.sourceforge.net/
 #include <tclap/CmdLine.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/random/mersenne_twister.hpp>
 
+#include "ColdFeatures.h"
+#include "NumaPlacement.h"
+#include "PerfCounters.h"
+#include "SentimentAggregator.h"
 #include "SentimentClassifier.h"
+#include "SparseFeatureWriter.h"
+#include "WorkerPool.h"
 
 using namespace std;
 
@@ -21,7 +29,9 @@ void print ( CDecision& cd )
 // write decision using tab-separated format
 // column 1: normalized content
 // column 2: feature set used to make decision
-// column 3: decision from [-1, 0, +1] ( score in parens )
+// column 3: decision from [-1, 0, +1] ( score in parens ); prefixed by ~
+//           if inherited from a near-duplicate; followed by the input
+//           classified in brackets if a budget truncated it
 {
 	cout << "\"" << cd.content << "\"\t";
 
@@ -31,6 +41,8 @@ void print ( CDecision& cd )
 			cout << cd.features[i] << "; ";
 	cout << ")\t";
 
+	if ( cd.inherited ) cout << "~";
+
 	if ( cd.confidence < 0 ) cout << "=";
 	else {
 		if ( cd.decision == 0 ) cout << "0 ";
@@ -40,6 +52,36 @@ void print ( CDecision& cd )
 				"; norm=" << cd.confidence << " )";
 	}
 
+	if ( cd.truncated )
+		cout << " [truncated: " << cd.bytes_processed << " bytes; " <<
+				cd.tokens_processed << " tokens; " <<
+				cd.sentences_processed << " sentences ]";
+
+	cout << endl;
+}
+
+void print ( WindowSummary& ws )
+// write window using tab-separated format
+// column 1: entity
+// column 2: window start and end ( seconds )
+// column 3: top features with summed scores
+// column 4: decision counts ( sums of raw score and confidence in parens )
+{
+	cout << "\"" << ws.entity << "\"\t";
+
+	cout << "[ " << ws.start << ", " << ws.end << " )\t";
+
+	cout << "( ";
+	for ( unsigned int i = 0; i < ws.top_features.size(); ++i )
+		cout << ws.top_features[i].first << " = " <<
+				ws.top_features[i].second << "; ";
+	cout << ")\t";
+
+	cout << "-1:" << ws.negative << " 0:" << ws.neutral <<
+			" +1:" << ws.positive << " =:" << ws.undecided;
+	cout << " ( raw=" << ws.raw_score <<
+			"; norm=" << ws.confidence << " )";
+
 	cout << endl;
 }
 
@@ -89,6 +131,259 @@ bool getContent( string& inputLine, string& title, string& body,
 	}
 }
 
+bool getFeedback( string& inputLine, int& label, string& rest )
+// splits label from the input columns of a feedback line
+{
+	size_t tab = inputLine.find ( char(9) );
+	if ( tab == string::npos )
+		return false;
+
+	stringstream str ( inputLine.substr ( 0, tab ) );
+	if ( ! ( str >> label ) )
+		return false;
+
+	rest = inputLine.substr ( tab + 1 );
+	return true;
+}
+
+bool getTimestamp( const string& field, boost::int64_t& timestamp )
+// parses seconds since epoch, or "YYYY-MM-DD HH:MM:SS"
+{
+	stringstream str ( field );
+	if ( ( str >> timestamp ) && str.eof() )
+		return true;
+
+	try {
+		boost::posix_time::ptime epoch ( boost::gregorian::date ( 1970, 1, 1 ) );
+		boost::posix_time::ptime time =
+			boost::posix_time::time_from_string ( field );
+		timestamp = ( time - epoch ).total_seconds();
+		return true;
+	} catch (...) {
+		return false;
+	}
+}
+
+void aggregate ( SentimentAggregator& aggregator, string& inputLine,
+		unsigned int key_column, unsigned int time_column,
+		CDecision& cd )
+// adds decision to the windows of its entity; writes windows that closed
+{
+	vector<string> strs;
+	split ( strs, inputLine, char(9) );
+
+	boost::int64_t timestamp;
+	if ( strs.size() != 10 || key_column >= 10 || time_column >= 10 ||
+		 ! getTimestamp ( strs[time_column], timestamp ) ) {
+		cerr << "Error parsing entity and timestamp! (\"" <<
+		inputLine << "\")" << endl;
+		return;
+	}
+
+	vector<WindowSummary> closed;
+	aggregator.Add ( strs[key_column], timestamp, cd, closed );
+
+	for ( unsigned int i = 0; i < closed.size(); ++i )
+		print ( closed[i] );
+}
+
+bool classifyFields ( SentimentClassifier& classifier, bool reference,
+		const vector<string>& fields, CDecision& cd, double& seconds )
+// classifies content, or title, body and url, with the chosen engine
+{
+	classifier.setReferenceEngine ( reference );
+
+	boost::posix_time::ptime start =
+		boost::posix_time::microsec_clock::universal_time();
+
+	bool status = ( fields.size() == 3 ) ?
+		classifier.Classify ( fields[0], fields[1], fields[2], cd ) :
+		classifier.Classify ( fields[0], cd );
+
+	seconds += ( boost::posix_time::microsec_clock::universal_time() -
+				 start ).total_microseconds() / 1e6;
+
+	classifier.setReferenceEngine ( false );
+	return status;
+}
+
+string mismatchedFields ( bool status_a, const CDecision& a,
+		bool status_b, const CDecision& b )
+// names of decision fields that differ; empty if the decisions are equal
+{
+	string fields;
+	if ( status_a != status_b ) fields += "status ";
+	if ( a.decision != b.decision ) fields += "decision ";
+	if ( a.raw_score != b.raw_score ) fields += "raw_score ";
+	if ( a.confidence != b.confidence ) fields += "confidence ";
+	if ( a.content != b.content ) fields += "content ";
+	if ( a.features != b.features ) fields += "features ";
+	if ( a.feature_scores != b.feature_scores ) fields += "feature_scores ";
+	return fields;
+}
+
+string compareEngines ( SentimentClassifier& classifier,
+		const vector<string>& fields, double& reference_seconds,
+		double& fast_seconds )
+// fields in which reference and fast engines disagree on one input
+{
+	CDecision reference, fast;
+	bool reference_status = classifyFields ( classifier, true, fields,
+											 reference, reference_seconds );
+	bool fast_status = classifyFields ( classifier, false, fields,
+										fast, fast_seconds );
+	return mismatchedFields ( reference_status, reference, fast_status, fast );
+}
+
+void minimizeMismatch ( SentimentClassifier& classifier,
+		vector<string>& fields )
+// shrinks each field by deleting ever smaller chunks while the engines
+// still disagree
+{
+	double unused = 0.;
+
+	for ( unsigned int f = 0; f < fields.size(); ++f ) {
+		for ( size_t chunk = fields[f].size() / 2; chunk > 0; chunk /= 2 ) {
+			size_t i = 0;
+			while ( i < fields[f].size() ) {
+				vector<string> candidate ( fields );
+				candidate[f].erase ( i, chunk );
+				if ( compareEngines ( classifier, candidate,
+									  unused, unused ) != "" )
+					fields.swap ( candidate );
+				else
+					i += chunk;
+			}
+		}
+	}
+}
+
+string fuzzInput ( boost::mt19937& rng, const vector<string>& phrases )
+// random text mixing model phrases with the inputs normalization handles
+// specially: unicode, long urls, runs of ?, empty sentences, tags, digits
+{
+	static const char* pieces[] = {
+		" ", "  ", ". ", "! ", "?", "???", "?????????? ", ";", ";;; ",
+		"!?!", " ; ; ", "'", "it's ", "don't ", "#tag ", "@user ",
+		" #", " @", "\xc3\xa9t\xc3\xa9 ", "\xe6\x97\xa5\xe6\x9c\xac ",
+		"\xf0\x9f\x98\x80 ", "na\xc3\xafve ", "12345 ", "3.14 ",
+		"HTTP://X.COM ", "http:", "https://secure.example.com/a?b=c ",
+		"http://example.com/a/b/c.html?x=1&y=2&z=3 ", "UPPER ", "MiXeD ",
+		"\t", "\r", "-- ", "(", ")", "\"", "...", "a", "i "
+	};
+	const unsigned int n_pieces = sizeof ( pieces ) / sizeof ( pieces[0] );
+
+	string input;
+	unsigned int length = rng() % 40;
+	if ( rng() % 50 == 0 )
+		length = 20000 + rng() % 20000;
+
+	for ( unsigned int i = 0; i < length; ++i ) {
+		unsigned int r = rng() % 10;
+		if ( r < 4 && ! phrases.empty() )
+			input += phrases[ rng() % phrases.size() ] + " ";
+		else if ( r == 4 ) {
+			input += "http://";
+			unsigned int url_length = rng() % 300;
+			for ( unsigned int u = 0; u < url_length; ++u )
+				input += "abc/.=&?_09"[ rng() % 11 ];
+			input += " ";
+		} else if ( r == 5 )
+			input += string ( 1 + rng() % 30, '?' );
+		else
+			input += pieces[ rng() % n_pieces ];
+	}
+
+	// inputs are single lines without tabs
+	for ( unsigned int i = 0; i < input.size(); ++i )
+		if ( input[i] == '\n' || input[i] == '\t' )
+			input[i] = ' ';
+
+	return input;
+}
+
+bool readPhrases ( const string& features_fn, vector<string>& phrases )
+// reads the phrases of a features file to seed fuzzed inputs
+{
+	ifstream fs ( features_fn.c_str() );
+	string phrase, entry;
+	while ( getline ( fs, phrase, '\t' ) && getline ( fs, entry ) )
+		phrases.push_back ( phrase );
+	return ! phrases.empty();
+}
+
+int runComparison ( SentimentClassifier& classifier, istream& in,
+		bool title_body_url, unsigned int fuzz_count, unsigned int seed,
+		const string& features_fn )
+// runs reference and fast engines side by side on each input line, then
+// on fuzzed inputs; reports mismatches with a minimized reproducer and
+// the speedup of the fast engine
+{
+	const unsigned int max_reports = 10;
+
+	double reference_seconds = 0., fast_seconds = 0.;
+	unsigned int compared = 0, mismatches = 0;
+
+	vector<string> phrases;
+	readPhrases ( features_fn, phrases );
+	boost::mt19937 rng ( seed );
+
+	string inputLine;
+	unsigned int fuzzed = 0;
+	while ( true ) {
+
+		vector<string> fields ( title_body_url ? 3 : 1 );
+		if ( getline ( in, inputLine ) && inputLine.length() > 0 ) {
+			bool parsed = title_body_url ?
+				getContent ( inputLine, fields[0], fields[1], fields[2] ) :
+				getContent ( inputLine, fields[0] );
+			if ( ! parsed ) {
+				cerr << "Error parsing input! (\"" << inputLine << "\")" << endl;
+				continue;
+			}
+		} else if ( fuzzed < fuzz_count ) {
+			for ( unsigned int f = 0; f < fields.size(); ++f )
+				fields[f] = fuzzInput ( rng, phrases );
+			fuzzed ++;
+		} else break;
+
+		compared ++;
+		string mismatch = compareEngines ( classifier, fields,
+										   reference_seconds, fast_seconds );
+		if ( mismatch == "" )
+			continue;
+
+		if ( ++mismatches > max_reports )
+			continue;
+
+		minimizeMismatch ( classifier, fields );
+
+		CDecision reference, fast;
+		double unused = 0.;
+		classifyFields ( classifier, true, fields, reference, unused );
+		classifyFields ( classifier, false, fields, fast, unused );
+
+		cout << "MISMATCH on input " << compared << " ( " << mismatch << ")" << endl;
+		cout << "minimized:\t\"";
+		for ( unsigned int f = 0; f < fields.size(); ++f )
+			cout << ( f ? "\t" : "" ) << fields[f];
+		cout << "\"" << endl;
+		cout << "reference:\t";
+		print ( reference );
+		cout << "fast:\t\t";
+		print ( fast );
+	}
+
+	cout << "Compared " << compared << " inputs (" << fuzzed << " fuzzed): " <<
+		mismatches << " mismatches" << endl;
+	cout << "reference engine: " << reference_seconds << " s; fast engine: " <<
+		fast_seconds << " s; speedup: " <<
+		( fast_seconds > 0. ? reference_seconds / fast_seconds : 0. ) <<
+		"x" << endl;
+
+	return mismatches > 0 ? 1 : 0;
+}
+
 int main(int argc, char **argv)
 {
 	const char* DescriptionMessage =
@@ -99,12 +394,46 @@ int main(int argc, char **argv)
 	string features_fn;
 	string stopwords_fn;  // this is currently ignored!
 
+	// filenames for labeled feedback & feedback counts snapshot
+	string feedback_fn;
+	string snapshot_fn;
+
+	// filename for sparse feature export; classification is skipped if set
+	string export_fn;
+
+	// tiered model: prefix of hot & cold files to build, cold segment to
+	// use, and feature frequencies to rank the hot tier by
+	string tier_prefix;
+	string cold_fn;
+	string ranking_fn;
+
 	// various defaults, can be changed
 	unsigned int debug_level = 1;
 	float relevance_cutoff = 1.0f;
 	float neutral_cutoff = 1.0f;
 	bool title_body_url = false;
 	bool question_marks = false;
+	bool aggregate_windows = false;
+	unsigned int key_column = 0;
+	unsigned int time_column = 0;
+	unsigned int window_size = 60;
+	unsigned int window_slide = 0;
+	unsigned int top_features = 5;
+	unsigned int threads = 0;
+	unsigned int parallel_threshold = 65536;
+	bool near_duplicates = false;
+	unsigned int duplicate_distance = 3;
+	unsigned int duplicate_memory = 64;
+	bool compare_engines = false;
+	unsigned int fuzz_count = 0;
+	unsigned int fuzz_seed = 1;
+	unsigned int hot_kb = 1024;
+	unsigned int cache_kb = 4096;
+	ClassifyBudget budget;
+	bool bounded = false;
+	bool huge_pages = false;
+	bool node_replicas = false;
+	bool perf_counters = false;
 	istream *in = &cin;
 
 	// various defaults, fixed
@@ -127,6 +456,120 @@ int main(int argc, char **argv)
 				"s","stopwords","Stopwords file to use [CURRENTLY IGNORED]",
 				false,"","string",cmd);
 
+		TCLAP::ValueArg<std::string> feedbackFilenameArg(
+				"l","learn","Labeled feedback file to learn from before "
+				"classifying (label, then input columns; tab-separated)",
+				false,"","string",cmd);
+
+		TCLAP::ValueArg<std::string> snapshotFilenameArg(
+				"k","snapshot","Feedback counts snapshot to load and update",
+				false,"","string",cmd);
+
+		TCLAP::ValueArg<std::string> exportFilenameArg(
+				"x","export","Export matched features as sparse vectors to "
+				"file instead of classifying",false,"","string",cmd);
+
+		TCLAP::ValueArg<unsigned int> aggregateKeyArg(
+				"a","aggregate_key","Aggregate decisions into time windows "
+				"per value of this input column (10-column input only)",
+				false,key_column,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> timeColumnArg(
+				"e","time_column","Input column holding the timestamp "
+				"(seconds or YYYY-MM-DD HH:MM:SS) used to aggregate",
+				false,time_column,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> windowSizeArg(
+				"w","window","Length of aggregation windows in seconds",
+				false,window_size,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> windowSlideArg(
+				"i","slide","Seconds between starts of sliding aggregation "
+				"windows (default: tumbling windows)",
+				false,window_slide,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> topFeaturesArg(
+				"o","top_features","Number of top features to report per "
+				"aggregation window",false,top_features,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> threadsArg(
+				"j","threads","Worker threads used to split large inputs",
+				false,threads,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> parallelThresholdArg(
+				"p","parallel_threshold","Min input bytes to classify in "
+				"parallel segments",false,parallel_threshold,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> duplicateDistanceArg(
+				"u","near_duplicates","Reuse decisions of recent documents "
+				"within this many bits of SimHash",false,duplicate_distance,
+				"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> duplicateMemoryArg(
+				"z","duplicates_memory","Memory cap of near-duplicate index "
+				"in MB",false,duplicate_memory,"unsigned int",cmd);
+
+		TCLAP::SwitchArg compareSwitch(
+				"g","compare","Compare the reference and fast engines on "
+				"every input and report mismatches and speedup",cmd,false);
+
+		TCLAP::ValueArg<unsigned int> fuzzCountArg(
+				"b","fuzz","Number of fuzzed inputs to compare after the "
+				"input file",false,fuzz_count,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> fuzzSeedArg(
+				"y","seed","Random seed of fuzzed inputs",false,fuzz_seed,
+				"unsigned int",cmd);
+
+		TCLAP::ValueArg<std::string> tierPrefixArg(
+				"T","tier_build","Split the features into PREFIX.hot and "
+				"PREFIX.cold files instead of classifying",
+				false,"","string",cmd);
+
+		TCLAP::ValueArg<unsigned int> hotSizeArg(
+				"H","hot_kb","Memory budget of the hot features tier in KB",
+				false,hot_kb,"unsigned int",cmd);
+
+		TCLAP::ValueArg<std::string> rankingFilenameArg(
+				"R","ranking","Feature frequencies (phrase, then count) "
+				"ranking features for the hot tier",false,"","string",cmd);
+
+		TCLAP::ValueArg<std::string> coldFilenameArg(
+				"C","cold_segment","Cold features segment backing the "
+				"features file",false,"","string",cmd);
+
+		TCLAP::ValueArg<unsigned int> cacheSizeArg(
+				"K","cache_kb","Cache of cold feature blocks in KB",
+				false,cache_kb,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> maxBytesArg(
+				"L","max_bytes","Budget of input bytes classified per text",
+				false,0,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> maxTokensArg(
+				"W","max_tokens","Budget of input words classified per text",
+				false,0,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> maxSentencesArg(
+				"S","max_sentences","Budget of sentences classified per text",
+				false,0,"unsigned int",cmd);
+
+		TCLAP::ValueArg<unsigned int> deadlineArg(
+				"D","deadline","Budget of wall-clock microseconds per text",
+				false,0,"unsigned int",cmd);
+
+		TCLAP::SwitchArg hugePagesSwitch(
+				"G","huge_pages","Serve features from a hash table in 2 MB "
+				"pages",cmd,false);
+
+		TCLAP::SwitchArg nodeReplicasSwitch(
+				"N","numa","Keep a feature table per NUMA node and bind "
+				"worker threads to nodes",cmd,false);
+
+		TCLAP::SwitchArg perfSwitch(
+				"P","perf","Report elapsed time, dTLB misses and remote "
+				"node loads of classification",cmd,false);
+
 		TCLAP::ValueArg<unsigned int> debugLevelArg(
 				"d","debug","Level of debug info to produce",false,debug_level,
 				"unsigned int",cmd);
@@ -155,6 +598,12 @@ int main(int argc, char **argv)
 
 		features_fn    = featuresFilenameArg.getValue();
 		stopwords_fn   = stopwordsFilenameArg.getValue();
+		feedback_fn    = feedbackFilenameArg.getValue();
+		snapshot_fn    = snapshotFilenameArg.getValue();
+		export_fn      = exportFilenameArg.getValue();
+		tier_prefix    = tierPrefixArg.getValue();
+		cold_fn        = coldFilenameArg.getValue();
+		ranking_fn     = rankingFilenameArg.getValue();
 		if ( inputFilenameArg.isSet() ) {
 			in = new ifstream ( inputFilenameArg.getValue().c_str() );
 		}
@@ -176,6 +625,76 @@ int main(int argc, char **argv)
 		if ( questionMarksSwitch.isSet() )
 			question_marks = questionMarksSwitch.getValue();
 
+		if ( aggregateKeyArg.isSet() ) {
+			aggregate_windows = true;
+			key_column = aggregateKeyArg.getValue();
+		}
+
+		if ( timeColumnArg.isSet() )
+			time_column = timeColumnArg.getValue();
+
+		if ( windowSizeArg.isSet() )
+			window_size = windowSizeArg.getValue();
+
+		if ( windowSlideArg.isSet() )
+			window_slide = windowSlideArg.getValue();
+
+		if ( topFeaturesArg.isSet() )
+			top_features = topFeaturesArg.getValue();
+
+		if ( threadsArg.isSet() )
+			threads = threadsArg.getValue();
+
+		if ( parallelThresholdArg.isSet() )
+			parallel_threshold = parallelThresholdArg.getValue();
+
+		if ( duplicateDistanceArg.isSet() ) {
+			near_duplicates = true;
+			duplicate_distance = duplicateDistanceArg.getValue();
+		}
+
+		if ( duplicateMemoryArg.isSet() )
+			duplicate_memory = duplicateMemoryArg.getValue();
+
+		if ( compareSwitch.isSet() )
+			compare_engines = compareSwitch.getValue();
+
+		if ( fuzzCountArg.isSet() )
+			fuzz_count = fuzzCountArg.getValue();
+
+		if ( fuzzSeedArg.isSet() )
+			fuzz_seed = fuzzSeedArg.getValue();
+
+		if ( hotSizeArg.isSet() )
+			hot_kb = hotSizeArg.getValue();
+
+		if ( cacheSizeArg.isSet() )
+			cache_kb = cacheSizeArg.getValue();
+
+		if ( maxBytesArg.isSet() )
+			budget.max_bytes = maxBytesArg.getValue();
+
+		if ( maxTokensArg.isSet() )
+			budget.max_tokens = maxTokensArg.getValue();
+
+		if ( maxSentencesArg.isSet() )
+			budget.max_sentences = maxSentencesArg.getValue();
+
+		if ( deadlineArg.isSet() )
+			budget.deadline_usec = deadlineArg.getValue();
+
+		if ( hugePagesSwitch.isSet() )
+			huge_pages = hugePagesSwitch.getValue();
+
+		if ( nodeReplicasSwitch.isSet() )
+			node_replicas = nodeReplicasSwitch.getValue();
+
+		if ( perfSwitch.isSet() )
+			perf_counters = perfSwitch.getValue();
+
+		bounded = maxBytesArg.isSet() || maxTokensArg.isSet() ||
+				  maxSentencesArg.isSet() || deadlineArg.isSet();
+
 	} catch (TCLAP::ArgException &e) {
 
 		cerr << "error: " << e.error() << " for arg " << e.argId() << endl;
@@ -187,7 +706,8 @@ int main(int argc, char **argv)
 	SentimentClassifier classifier( features_fn, stopwords_fn );
 
 	// If DebugLevel == 0, classifier generates no msgs to stdout/stderr
-	classifier.setDebugLevel ( debug_level );
+	// (aggregation needs plain feature phrases, so it always uses 0)
+	classifier.setDebugLevel ( aggregate_windows ? 0 : debug_level );
 
 	// MaxFeatureSize is the max N-gram size in feature set
 	classifier.setMaxFeatureSize ( max_feature_size );
@@ -201,9 +721,173 @@ int main(int argc, char **argv)
 	// Sets whether question marks should be used as a feature
 	classifier.setUseQuestionMarks( question_marks );
 
+	// Counters cover worker threads, so they are opened before the pool
+	PerfCounters counters;
+
+	// With replicas per node, the classifying thread stays on the node it
+	// starts on, like the pool's threads, so it always reads a local one
+	if ( node_replicas && ! bindThreadToNode ( currentNode () ) )
+		cerr << "Failed to bind the classifying thread to its node." << endl;
+
+	// Large inputs are split across worker threads
+	if ( threads > 0 )
+		classifier.setWorkerPool ( boost::shared_ptr<WorkerPool> (
+			new WorkerPool ( threads, node_replicas ) ) );
+	classifier.setParallelThreshold ( parallel_threshold );
+
+	// Near-duplicates of recent documents reuse their decisions
+	// (not when comparing engines; reuse is approximate by design)
+	if ( near_duplicates && ! compare_engines )
+		classifier.setNearDuplicates ( duplicate_distance,
+									   duplicate_memory * 1048576 );
+
 	// Inited checks where files are properly loaded
 	if ( classifier.Inited() ) {
 
+		// Features missing from the (hot) features file are read from disk
+		if ( cold_fn.length() > 0 &&
+				! classifier.openColdFeatures ( cold_fn, cache_kb * 1024 ) ) {
+			cerr << classifier.getErrorMsg() << endl;
+			return 1;
+		}
+
+		// Features are read from flat tables in huge pages or per node
+		if ( huge_pages || node_replicas ) {
+			if ( ! classifier.setModelPlacement ( huge_pages,
+												  node_replicas ) ) {
+				cerr << classifier.getErrorMsg() << endl;
+				return 1;
+			}
+
+			for ( unsigned int i = 0; i < classifier.getModelReplicas(); ++i ) {
+				PlacedRegion region;
+				classifier.getModelRegion ( i, region );
+				cerr << "Features replica " << i << ": " <<
+					region.bytes / 1024 << " KB on node " << region.node <<
+					( region.huge_pages ? ", huge pages" :
+					  region.transparent ? ", transparent huge pages" :
+										   ", small pages" ) << endl;
+			}
+		}
+
+		// Build a tiered model instead of classifying
+		if ( tier_prefix.length() > 0 ) {
+			if ( ! classifier.saveTiers ( tier_prefix + ".hot",
+					tier_prefix + ".cold", hot_kb * 1024, ranking_fn ) ) {
+				cerr << classifier.getErrorMsg() << endl;
+				return 1;
+			}
+			return 0;
+		}
+
+		// Feedback counts from earlier runs survive in the snapshot
+		if ( snapshot_fn.length() > 0 ) {
+			ifstream snapshot ( snapshot_fn.c_str() );
+			if ( snapshot.good() && ! classifier.loadFeedback ( snapshot_fn ) )
+				cerr << classifier.getErrorMsg() << endl;
+			classifier.setFeedbackSnapshot ( snapshot_fn, 1000 );
+		}
+
+		// Learn from labeled feedback before classifying
+		if ( feedback_fn.length() > 0 ) {
+			ifstream feedback ( feedback_fn.c_str() );
+			string feedbackLine;
+
+			while ( getline ( feedback, feedbackLine ) ) {
+				int label;
+				string rest, title, body, url, content;
+				bool parsed = getFeedback ( feedbackLine, label, rest );
+
+				if ( parsed && title_body_url )
+					parsed = getContent ( rest, title, body, url ) &&
+						classifier.Update ( title, body, url, label );
+				else if ( parsed )
+					parsed = getContent ( rest, content ) &&
+						classifier.Update ( content, label );
+
+				if ( ! parsed )
+					cerr << "Error learning feedback! (\"" <<
+					feedbackLine << "\")" << endl;
+			}
+
+			classifier.publishUpdates ();
+			if ( snapshot_fn.length() > 0 &&
+					! classifier.saveFeedback ( snapshot_fn ) )
+				cerr << classifier.getErrorMsg() << endl;
+		}
+
+		// Compare engines instead of printing decisions; the reference
+		// engine reads only the features file
+		if ( compare_engines && cold_fn.length() > 0 ) {
+			cerr << "Comparing engines needs the full features file, "
+				"not a cold segment" << endl;
+			return 1;
+		}
+		if ( compare_engines )
+			return runComparison ( classifier, *in, title_body_url,
+								   fuzz_count, fuzz_seed, features_fn );
+
+		// Export matched features instead of classifying
+		if ( export_fn.length() > 0 ) {
+
+			SparseFeatureWriter writer ( export_fn );
+			if ( ! writer.Inited() ) {
+				cerr << writer.getErrorMsg() << endl;
+				return 1;
+			}
+
+			string inputLine;
+			while ( getline ( *in, inputLine ) ) {
+
+				if ( inputLine.length() == 0 )
+					break;
+
+				// unparsable lines still get an (empty) row to keep
+				// rows aligned with input lines
+				SparseVector features;
+				string title, body, url, content;
+
+				if ( title_body_url ) {
+					if ( ! getContent ( inputLine, title, body, url ) ||
+						 ! classifier.Extract ( title, body, url, features ) )
+						cerr << "Error parsing title, body and url! (\"" <<
+						inputLine << "\")" << endl;
+				} else {
+					if ( ! getContent ( inputLine, content ) ||
+						 ! classifier.Extract ( content, features ) )
+						cerr << "Error parsing content! (\"" <<
+						inputLine << "\")"<< endl;
+				}
+
+				writer.Write ( features );
+			}
+
+			if ( ! writer.Close() ||
+				 ! classifier.saveFeatureIds ( export_fn + ".ids" ) ) {
+				cerr << "Failed to write export file!" << endl;
+				return 1;
+			}
+
+			if ( debug_level > 0 )
+				cerr << "Exported " << writer.getRows() << " rows, " <<
+					writer.getEntries() << " features" << endl;
+
+			return 0;
+		}
+
+		// Windows are only kept for entities seen within the last window
+		SentimentAggregator aggregator ( window_size, window_slide,
+										 top_features );
+
+		// Decisions truncated by budgets, in total and per BudgetLimit bit
+		unsigned long decisions = 0, truncated = 0;
+		unsigned long truncated_by[4] = { 0, 0, 0, 0 };
+
+		boost::posix_time::ptime started =
+			boost::posix_time::microsec_clock::universal_time();
+		if ( perf_counters )
+			counters.Start ();
+
 		// Loop over inputs
 		while ( in->good() ) {
 
@@ -222,8 +906,15 @@ int main(int argc, char **argv)
 				string title, body, url;
 
 				if ( getContent ( inputLine, title, body, url ) ) {
-					classifier.Classify ( title, body, url, decision);
-					print ( decision );
+					if ( bounded )
+						classifier.Classify ( title, body, url, budget,
+											  decision );
+					else
+						classifier.Classify ( title, body, url, decision);
+					if ( aggregate_windows )
+						aggregate ( aggregator, inputLine,
+									key_column, time_column, decision );
+					else print ( decision );
 				} else
 					cerr << "Error parsing title, body and url! (\"" <<
 					inputLine << "\")" << endl;
@@ -235,18 +926,83 @@ int main(int argc, char **argv)
 				string content;
 
 				if ( getContent ( inputLine, content ) ) {
-					classifier.Classify ( content, decision );
-					print ( decision );
+					if ( bounded )
+						classifier.Classify ( content, budget, decision );
+					else
+						classifier.Classify ( content, decision );
+					if ( aggregate_windows )
+						aggregate ( aggregator, inputLine,
+									key_column, time_column, decision );
+					else print ( decision );
 				} else
 					cerr << "Error parsing content! (\"" <<
 					inputLine << "\")"<< endl;
 
 			}
 
-			if ( debug_level > 1 ) cout << endl;
+			if ( debug_level > 1 && ! aggregate_windows ) cout << endl;
+
+			decisions ++;
+			if ( decision.truncated ) {
+				truncated ++;
+				for ( unsigned int b = 0; b < 4; ++b )
+					if ( decision.truncated & ( 1 << b ) )
+						truncated_by[b] ++;
+			}
+		}
+
+		if ( perf_counters ) {
+			counters.Stop ();
+			double seconds = ( boost::posix_time::microsec_clock::
+				universal_time() - started ).total_microseconds() / 1e6;
+
+			cerr << "Perf: " << decisions << " decisions in " << seconds <<
+				" s (" << ( seconds > 0 ? decisions / seconds : 0 ) << "/s)";
+			for ( int e = 0; e < PerfCounters::Events; ++e ) {
+				PerfCounters::Event event = PerfCounters::Event ( e );
+				cerr << "; " << PerfCounters::getName ( event ) << " ";
+				if ( counters.Available ( event ) )
+					cerr << counters.getCount ( event );
+				else
+					cerr << "unavailable";
+			}
+			cerr << endl;
+		}
 
+		if ( bounded && decisions > 0 )
+			cerr << "Budgets: " << truncated << " of " << decisions <<
+				" decisions truncated (" << 100.0 * truncated / decisions <<
+				"%); bytes " << truncated_by[0] << ", tokens " <<
+				truncated_by[1] << ", sentences " << truncated_by[2] <<
+				", deadline " << truncated_by[3] << endl;
+
+		if ( aggregate_windows ) {
+			vector<WindowSummary> closed;
+			aggregator.Flush ( closed );
+			for ( unsigned int i = 0; i < closed.size(); ++i )
+				print ( closed[i] );
+
+			if ( aggregator.getDroppedLate() > 0 )
+				cerr << "Dropped " << aggregator.getDroppedLate() <<
+					" decisions arriving after their windows closed" << endl;
 		}
 
+		if ( near_duplicates && classifier.getDuplicatesChecked() > 0 )
+			cerr << "Near-duplicates: " <<
+				classifier.getDuplicatesInherited() << " of " <<
+				classifier.getDuplicatesChecked() << " decisions inherited (" <<
+				100.0 * classifier.getDuplicatesInherited() /
+					classifier.getDuplicatesChecked() << "%)" << endl;
+
+		ColdCounters cold_counters;
+		if ( classifier.getColdCounters ( cold_counters ) &&
+				cold_counters.lookups > 0 )
+			cerr << "Cold features: " << cold_counters.lookups <<
+				" lookups, " << cold_counters.bloom_rejects <<
+				" Bloom rejects, " << cold_counters.cache_hits <<
+				" cache hits, " << cold_counters.block_loads <<
+				" block loads, " << cold_counters.hits << " hits" << endl;
+
 		return 0;
 
 	} else {
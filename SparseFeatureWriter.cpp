@@ -0,0 +1,106 @@
+/*
+ * SparseFeatureWriter.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "SparseFeatureWriter.h"
+
+#include <string.h>
+
+SparseFeatureWriter::SparseFeatureWriter ( const string& export_file )
+	: out ( export_file.c_str(), ios::out | ios::binary | ios::trunc ),
+	  index ( 1, 0 ), error_msg (), isInited (false), isClosed (false)
+{
+	// header is rewritten with final counts on Close
+	SparseFeatureHeader header;
+	memset ( &header, 0, sizeof ( header ) );
+
+	if ( out.good() ) {
+		out.write ( reinterpret_cast<const char*> ( &header ),
+					sizeof ( header ) );
+		isInited = out.good();
+	}
+
+	if ( ! isInited )
+		error_msg = "Failed to open export file.";
+}
+
+SparseFeatureWriter::~SparseFeatureWriter ()
+{
+	Close ();
+}
+
+bool SparseFeatureWriter::Inited () const
+// return true if the export file is open for writing
+{
+	return isInited;
+}
+
+bool SparseFeatureWriter::Write ( const SparseVector& sv )
+// append one document's features as the next row
+{
+	if ( ! isInited || isClosed ) {
+		error_msg = "export file is not open";
+		return false;
+	}
+
+	if ( ! sv.empty() )
+		out.write ( reinterpret_cast<const char*> ( &sv[0] ),
+					sv.size() * sizeof ( SparseFeature ) );
+	index.push_back ( index.back() + sv.size() );
+
+	if ( ! out.good() ) {
+		error_msg = "Failed to write export file.";
+		return false;
+	}
+
+	return true;
+}
+
+bool SparseFeatureWriter::Close ()
+// write the row index and final header; return false on error
+{
+	if ( ! isInited || isClosed )
+		return isClosed;
+
+	isClosed = true;
+
+	SparseFeatureHeader header;
+	memset ( &header, 0, sizeof ( header ) );
+	memcpy ( header.magic, "SCSF", 4 );
+	header.version = Version;
+	header.rows = index.size() - 1;
+	header.entries = index.back();
+	header.index_offset =
+		sizeof ( header ) + header.entries * sizeof ( SparseFeature );
+
+	out.write ( reinterpret_cast<const char*> ( &index[0] ),
+				index.size() * sizeof ( boost::uint64_t ) );
+	out.seekp ( 0 );
+	out.write ( reinterpret_cast<const char*> ( &header ),
+				sizeof ( header ) );
+	out.close ();
+
+	if ( out.fail() ) {
+		error_msg = "Failed to write export file.";
+		return false;
+	}
+
+	return true;
+}
+
+boost::uint64_t SparseFeatureWriter::getRows () const
+{
+	return index.size() - 1;
+}
+
+boost::uint64_t SparseFeatureWriter::getEntries () const
+{
+	return index.back();
+}
+
+string SparseFeatureWriter::getErrorMsg () const
+{
+	return error_msg;
+}
@@ -0,0 +1,58 @@
+/*
+ * SparseFeatureWriter.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef SPARSEFEATUREWRITER_H_
+#define SPARSEFEATUREWRITER_H_
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "SentimentClassifier.h"
+
+using namespace std;
+
+// Export file layout (native byte order, every section 8-byte aligned so
+// the file can be memory-mapped and read in place):
+//
+//   header   magic "SCSF", version, rows, entries, offset of row index
+//   entries  SparseFeature[ entries ], rows stored back to back
+//   index    uint64[ rows + 1 ]; row r spans entries [ index[r], index[r+1] )
+
+struct SparseFeatureHeader
+// data structure for the header of a sparse feature export file
+{
+	char magic[4];
+	boost::uint32_t version;
+	boost::uint64_t rows;
+	boost::uint64_t entries;
+	boost::uint64_t index_offset;
+};
+
+class SparseFeatureWriter {
+public:
+	SparseFeatureWriter ( const string& export_file );
+	~SparseFeatureWriter ();
+	bool Inited () const;
+	bool Write ( const SparseVector& sv );
+	bool Close ();
+
+	boost::uint64_t getRows () const;
+	boost::uint64_t getEntries () const;
+	string getErrorMsg () const;
+
+private:
+	ofstream out;
+	vector<boost::uint64_t> index;
+	string error_msg;
+	bool isInited;
+	bool isClosed;
+
+	static const boost::uint32_t Version = 1;
+};
+
+#endif /* SPARSEFEATUREWRITER_H_ */
@@ -0,0 +1,35 @@
+/*
+ * TextUtils.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "TextUtils.h"
+
+#include <ctype.h>
+
+size_t urlSpan ( const string& content, size_t i, bool fold_case )
+// length of the http: url at i as the classifier's url pattern matches it,
+// or 0 if there is none
+{
+	static const char scheme[] = "http:";
+
+	size_t j = i;
+	for ( unsigned int k = 0; k < 5; ++k, ++j ) {
+		if ( j >= content.size() ) return 0;
+		char c = content[j];
+		if ( fold_case ) c = tolower ( (unsigned char) c );
+		if ( c != scheme[k] ) return 0;
+	}
+
+	size_t begin = j;
+	while ( j < content.size() ) {
+		unsigned char c = content[j];
+		if ( ! isalnum ( c ) && c != '_' && c != '/' && c != '.' &&
+				c != '=' && c != '&' && c != '?' )
+			break;
+		++j;
+	}
+
+	return ( j > begin ) ? j - i : 0;
+}
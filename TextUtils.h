@@ -0,0 +1,18 @@
+/*
+ * TextUtils.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef TEXTUTILS_H_
+#define TEXTUTILS_H_
+
+#include <string>
+
+using namespace std;
+
+// scanners over raw text shared by the classifier and the duplicate index
+
+size_t urlSpan ( const string& content, size_t i, bool fold_case );
+
+#endif /* TEXTUTILS_H_ */
@@ -0,0 +1,98 @@
+/*
+ * WorkerPool.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "WorkerPool.h"
+#include "NumaPlacement.h"
+
+#include <boost/bind/bind.hpp>
+
+WorkerPool::WorkerPool ( unsigned int threads, bool bind_nodes )
+	: lock (), ready (), done (), jobs (), workers (), Threads (threads),
+	  BindNodes (bind_nodes), isStopping (false)
+{
+	for ( unsigned int i = 0; i < Threads; ++i )
+		workers.create_thread ( boost::bind ( &WorkerPool::work, this, i ) );
+}
+
+WorkerPool::~WorkerPool ()
+{
+	{
+		boost::mutex::scoped_lock held ( lock );
+		isStopping = true;
+	}
+	ready.notify_all ();
+	workers.join_all ();
+}
+
+void WorkerPool::Run ( const vector<Task>& tasks )
+// run tasks on the pool and the calling thread; return when all finished
+{
+	unsigned int remaining = tasks.size();
+
+	boost::mutex::scoped_lock held ( lock );
+
+	for ( unsigned int i = 0; i < tasks.size(); ++i ) {
+		Job job;
+		job.task = tasks[i];
+		job.remaining = &remaining;
+		jobs.push_back ( job );
+	}
+	ready.notify_all ();
+
+	while ( remaining > 0 ) {
+		if ( ! jobs.empty() )
+			runOne ( held );
+		else
+			done.wait ( held );
+	}
+}
+
+unsigned int WorkerPool::getThreads () const
+{
+	return Threads;
+}
+
+bool WorkerPool::getBindNodes () const
+{
+	return BindNodes;
+}
+
+void WorkerPool::work ( unsigned int thread )
+{
+	// binding is best effort; an unbound thread still runs tasks
+	if ( BindNodes )
+		bindThreadToNode ( thread % numaNodes() );
+
+	boost::mutex::scoped_lock held ( lock );
+
+	while ( true ) {
+		while ( jobs.empty() && ! isStopping )
+			ready.wait ( held );
+
+		if ( jobs.empty() )
+			return;
+
+		runOne ( held );
+	}
+}
+
+void WorkerPool::runOne ( boost::mutex::scoped_lock& held )
+// pop and run the oldest job with the lock released
+{
+	Job job = jobs.front();
+	jobs.pop_front ();
+
+	held.unlock ();
+	try {
+		job.task ();
+	} catch (...) {
+		// tasks report their own errors
+	}
+	held.lock ();
+
+	if ( -- *job.remaining == 0 )
+		done.notify_all ();
+}
@@ -0,0 +1,52 @@
+/*
+ * WorkerPool.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <vector>
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace std;
+
+class WorkerPool {
+// fixed set of threads running batches of tasks; may be shared by several
+// classifiers. The thread calling Run works on queued tasks too, so tasks
+// may themselves Run nested batches without starving the pool. Threads may
+// be bound to NUMA nodes round-robin, so each reads its local model replica.
+public:
+	typedef boost::function<void ()> Task;
+
+	WorkerPool ( unsigned int threads, bool bind_nodes = false );
+	~WorkerPool ();
+	void Run ( const vector<Task>& tasks );
+	unsigned int getThreads () const;
+	bool getBindNodes () const;
+
+private:
+	struct Job {
+		Task task;
+		unsigned int* remaining;
+	};
+
+	boost::mutex lock;
+	boost::condition_variable ready;
+	boost::condition_variable done;
+	deque<Job> jobs;
+	boost::thread_group workers;
+	unsigned int Threads;
+	bool BindNodes;
+	bool isStopping;
+
+	void work ( unsigned int thread );
+	void runOne ( boost::mutex::scoped_lock& held );
+};
+
+#endif /* WORKERPOOL_H_ */